@@ -0,0 +1,32 @@
+#include "BaselineAccumulator.h"
+#include <cstring>
+
+void BaselineAccumulator::reset() {
+  memset(counts, 0, sizeof(counts));
+  samples = 0;
+}
+
+void BaselineAccumulator::add(const PackedScan &scan) {
+  for (int d = 0; d < SCAN_WINDOW_DEVICES; d++) {
+    uint64_t bits = scan.bits[d];
+    while (bits) {
+      int i = __builtin_ctzll(bits);
+      bits &= bits - 1;
+      if (i < BASELINE_INPUTS_PER_DEVICE && counts[d][i] < 255)
+        counts[d][i]++;
+    }
+  }
+  if (samples < 255)
+    samples++;
+}
+
+void BaselineAccumulator::result(uint8_t minVotes,
+                                 uint64_t out[SCAN_WINDOW_DEVICES]) const {
+  for (int d = 0; d < SCAN_WINDOW_DEVICES; d++) {
+    uint64_t bits = 0;
+    for (int i = 0; i < BASELINE_INPUTS_PER_DEVICE; i++)
+      if (counts[d][i] >= minVotes)
+        bits |= 1ULL << i;
+    out[d] = bits;
+  }
+}
@@ -0,0 +1,29 @@
+#ifndef BASELINEACCUMULATOR_H
+#define BASELINEACCUMULATOR_H
+
+#include "ScanWindow.h"
+#include <Arduino.h>
+
+#define BASELINE_INPUTS_PER_DEVICE 48
+
+// 流式基线累加器：逐次扫描累加每路输入为 1 的次数 (饱和于 255)，
+// 最终以 k-of-N 投票得到基线，无需保存 N 份完整快照
+class BaselineAccumulator {
+private:
+  uint8_t counts[SCAN_WINDOW_DEVICES][BASELINE_INPUTS_PER_DEVICE];
+  uint8_t samples;
+
+public:
+  BaselineAccumulator() { reset(); }
+
+  void reset();
+  void add(const PackedScan &scan);
+  uint8_t getSamples() const { return samples; }
+  uint8_t getCount(int device, int input) const {
+    return counts[device][input];
+  }
+  // 计数 >= minVotes 的输入置 1
+  void result(uint8_t minVotes, uint64_t out[SCAN_WINDOW_DEVICES]) const;
+};
+
+#endif
@@ -0,0 +1,126 @@
+#include "BeamAvailability.h"
+#include <cstring>
+
+static_assert(AVAIL_BLOCK_SCANS < (1 << AVAIL_COUNTER_BITS),
+              "AVAIL_BLOCK_SCANS exceeds counter width");
+static_assert(AVAIL_BLOCK_SCANS * AVAIL_BEAMS_PER_SCAN >= AVAIL_TOTAL_BEAMS,
+              "availability update must finish within one block");
+
+#define AVAIL_LOW_Q16 ((uint32_t)AVAIL_LOW_PERCENT * 65535 / 100)
+#define AVAIL_RECOVER_Q16 ((uint32_t)AVAIL_RECOVER_PERCENT * 65535 / 100)
+
+BeamAvailability availability;
+
+void BeamAvailability::reset() {
+  memset(tracked, 0, sizeof(tracked));
+  memset(live, 0, sizeof(live));
+  memset(liveSamples, 0, sizeof(liveSamples));
+  memset(snapshot, 0, sizeof(snapshot));
+  memset(snapshotSamples, 0, sizeof(snapshotSamples));
+  blockScans = 0;
+  cursor = AVAIL_TOTAL_BEAMS;
+  for (int d = 0; d < AVAIL_DEVICES; d++)
+    for (int i = 0; i < AVAIL_INPUTS; i++)
+      availability[d][i] = 65535;
+  memset(lowMask, 0, sizeof(lowMask));
+  memset(newlyLow, 0, sizeof(newlyLow));
+  memset(recovered, 0, sizeof(recovered));
+}
+
+void BeamAvailability::setTracked(int device, uint64_t mask) {
+  tracked[device] = mask;
+  // 不再统计的光束直接解除标记，不计为恢复
+  lowMask[device] &= mask;
+  newlyLow[device] &= mask;
+}
+
+void BeamAvailability::add(int device, uint64_t inputs) {
+  uint64_t carry = inputs & tracked[device];
+  for (int j = 0; j < AVAIL_COUNTER_BITS && carry; j++) {
+    uint64_t next = live[device][j] & carry;
+    live[device][j] ^= carry;
+    carry = next;
+  }
+  liveSamples[device]++;
+}
+
+bool BeamAvailability::endScan() {
+  if (++blockScans >= AVAIL_BLOCK_SCANS) {
+    memcpy(snapshot, live, sizeof(snapshot));
+    memcpy(snapshotSamples, liveSamples, sizeof(snapshotSamples));
+    memset(live, 0, sizeof(live));
+    memset(liveSamples, 0, sizeof(liveSamples));
+    blockScans = 0;
+    cursor = 0;
+  }
+
+  bool changed = false;
+  for (int n = 0; n < AVAIL_BEAMS_PER_SCAN && cursor < AVAIL_TOTAL_BEAMS;
+       n++, cursor++) {
+    if (processBeam(cursor / AVAIL_INPUTS, cursor % AVAIL_INPUTS))
+      changed = true;
+  }
+  return changed;
+}
+
+bool BeamAvailability::processBeam(int device, int input) {
+  uint64_t bit = 1ULL << input;
+  // 读取失败的设备本块没有样本，保持原值
+  if (!(tracked[device] & bit) || snapshotSamples[device] == 0)
+    return false;
+
+  uint32_t count = 0;
+  for (int j = 0; j < AVAIL_COUNTER_BITS; j++)
+    count |= (uint32_t)((snapshot[device][j] >> input) & 1) << j;
+  int32_t sample = count * 65535 / snapshotSamples[device];
+  int32_t value = availability[device][input];
+  value += (sample - value) / (1 << AVAIL_EWMA_SHIFT);
+  availability[device][input] = value;
+
+  if (!(lowMask[device] & bit) && (uint32_t)value < AVAIL_LOW_Q16) {
+    lowMask[device] |= bit;
+    newlyLow[device] |= bit;
+    recovered[device] &= ~bit;
+    return true;
+  }
+  if ((lowMask[device] & bit) && (uint32_t)value >= AVAIL_RECOVER_Q16) {
+    lowMask[device] &= ~bit;
+    recovered[device] |= bit;
+    newlyLow[device] &= ~bit;
+    return true;
+  }
+  return false;
+}
+
+void BeamAvailability::takeChanges(uint64_t low[AVAIL_DEVICES],
+                                   uint64_t recoveredOut[AVAIL_DEVICES]) {
+  memcpy(low, newlyLow, sizeof(newlyLow));
+  memcpy(recoveredOut, recovered, sizeof(recovered));
+  memset(newlyLow, 0, sizeof(newlyLow));
+  memset(recovered, 0, sizeof(recovered));
+}
+
+// 未参与统计的光束 (不在基线中或已屏蔽) 输出 null；low 为被标记为不可靠的输入号 (1-48)
+void BeamAvailability::writeJSON(Print &out) const {
+  out.printf("{\"lowPercent\":%d,\"recoverPercent\":%d", AVAIL_LOW_PERCENT,
+             AVAIL_RECOVER_PERCENT);
+  for (int d = 0; d < AVAIL_DEVICES; d++) {
+    out.printf(",\"device%d\":{\"percent\":[", d + 1);
+    for (int i = 0; i < AVAIL_INPUTS; i++) {
+      if (i)
+        out.print(',');
+      if (tracked[d] & (1ULL << i))
+        out.print(getPercent(d, i));
+      else
+        out.print("null");
+    }
+    out.print("],\"low\":[");
+    bool first = true;
+    for (uint64_t m = lowMask[d]; m; m &= m - 1) {
+      out.printf(first ? "%d" : ",%d", __builtin_ctzll(m) + 1);
+      first = false;
+    }
+    out.print("]}");
+  }
+  out.print('}');
+}
@@ -0,0 +1,73 @@
+#ifndef BEAMAVAILABILITY_H
+#define BEAMAVAILABILITY_H
+
+#include <Arduino.h>
+
+#define AVAIL_DEVICES 4
+#define AVAIL_INPUTS 48
+#define AVAIL_TOTAL_BEAMS (AVAIL_DEVICES * AVAIL_INPUTS)
+#define AVAIL_COUNTER_BITS 6 // 块内计数上限 63
+
+#ifndef AVAIL_BLOCK_SCANS
+#define AVAIL_BLOCK_SCANS 32 // 每块扫描次数，块结束后把在线比例并入 EWMA
+#endif
+#ifndef AVAIL_EWMA_SHIFT
+#define AVAIL_EWMA_SHIFT 6 // EWMA 系数 1/64，约 64 块 (~1 分钟) 的时间常数
+#endif
+#ifndef AVAIL_BEAMS_PER_SCAN
+#define AVAIL_BEAMS_PER_SCAN 8 // 每轮扫描摊还更新的光束数
+#endif
+#ifndef AVAIL_LOW_PERCENT
+#define AVAIL_LOW_PERCENT 50 // 可用率低于该值标记为不可靠
+#endif
+#ifndef AVAIL_RECOVER_PERCENT
+#define AVAIL_RECOVER_PERCENT 70 // 回升到该值以上解除标记 (迟滞)
+#endif
+
+// 逐光束可用率估计：基线光束处于 "在线" (未被遮挡) 状态的时间比例，Q16 定点 EWMA。
+// 每轮扫描只对每台设备做一次位切片加法 (O(设备数) 次整字运算)；
+// 每 AVAIL_BLOCK_SCANS 轮把块内计数快照下来，在随后的扫描中每轮摊还更新
+// AVAIL_BEAMS_PER_SCAN 路光束的 EWMA 和标记。
+class BeamAvailability {
+private:
+  uint64_t tracked[AVAIL_DEVICES]; // 参与统计的光束 (基线中且未屏蔽)
+  uint64_t live[AVAIL_DEVICES][AVAIL_COUNTER_BITS];
+  uint8_t liveSamples[AVAIL_DEVICES];
+  uint64_t snapshot[AVAIL_DEVICES][AVAIL_COUNTER_BITS];
+  uint8_t snapshotSamples[AVAIL_DEVICES];
+  uint8_t blockScans;
+  uint16_t cursor; // 快照中下一路待处理的光束，AVAIL_TOTAL_BEAMS 表示处理完毕
+
+  uint16_t availability[AVAIL_DEVICES][AVAIL_INPUTS]; // 65535 = 100%
+  uint64_t lowMask[AVAIL_DEVICES];
+  uint64_t newlyLow[AVAIL_DEVICES];
+  uint64_t recovered[AVAIL_DEVICES];
+
+  bool processBeam(int device, int input);
+
+public:
+  BeamAvailability() { reset(); }
+
+  // 清空统计，全部光束视为 100% 可用 (重新建立基线时)
+  void reset();
+  void setTracked(int device, uint64_t mask);
+  // 写入设备 (0-3) 本轮扫描的输入位图 (bit i = 输入 i+1 为 1)
+  void add(int device, uint64_t inputs);
+  // 每轮扫描结束调用一次；有光束被标记或解除标记时返回 true
+  bool endScan();
+  // 取出并清空自上次调用以来新标记/解除标记的光束
+  void takeChanges(uint64_t low[AVAIL_DEVICES],
+                   uint64_t recoveredOut[AVAIL_DEVICES]);
+
+  // 可用率百分比 (0-100)
+  uint8_t getPercent(int device, int input) const {
+    return (uint32_t)availability[device][input] * 100 / 65535;
+  }
+  // {"lowPercent":..,"recoverPercent":..,"device1":{"percent":[48],"low":[..]},...}
+  void writeJSON(Print &out) const;
+};
+
+// [新增] 逐光束可用率 (漂移/积灰检测)，扫描中更新，/api/availability 读取
+extern BeamAvailability availability;
+
+#endif
@@ -0,0 +1,77 @@
+#include "BeamStats.h"
+#include <cstring>
+
+BeamStats beamStats;
+
+void BeamStats::reset(unsigned long nowMs) {
+  memset(prev, 0, sizeof(prev));
+  prevValid = 0;
+  memset(current, 0, sizeof(current));
+  memset(lastWindow, 0, sizeof(lastWindow));
+  memset(dropouts, 0, sizeof(dropouts));
+  windowStart = nowMs;
+  haveLastWindow = false;
+}
+
+void BeamStats::update(const PackedScan &scan) {
+  if (scan.timeMs - windowStart >= BEAMSTATS_WINDOW_MS) {
+    memcpy(lastWindow, current, sizeof(lastWindow));
+    memset(current, 0, sizeof(current));
+    windowStart = scan.timeMs;
+    haveLastWindow = true;
+  }
+
+  for (int d = 0; d < BEAMSTATS_DEVICES; d++) {
+    if (!(scan.validMask & (1 << d)))
+      continue;
+    uint64_t bits = scan.bits[d];
+    if (prevValid & (1 << d)) {
+      uint64_t flips = bits ^ prev[d];
+      for (uint64_t m = flips; m; m &= m - 1) {
+        int i = __builtin_ctzll(m);
+        if (current[d][i] < 0xFFFF)
+          current[d][i]++;
+      }
+      for (uint64_t m = flips & prev[d]; m; m &= m - 1)
+        dropouts[d][__builtin_ctzll(m)]++;
+    }
+    prev[d] = bits;
+    prevValid |= 1 << d;
+  }
+}
+
+uint16_t BeamStats::flickerPerMin(int device, int input,
+                                  unsigned long nowMs) const {
+  if (haveLastWindow)
+    return (uint32_t)lastWindow[device][input] * 60000 / BEAMSTATS_WINDOW_MS;
+  unsigned long elapsed = nowMs - windowStart;
+  if (elapsed < 1000)
+    elapsed = 1000; // 刚开始统计时避免放大
+  uint32_t rate = (uint32_t)current[device][input] * 60000 / elapsed;
+  return rate > 0xFFFF ? 0xFFFF : rate;
+}
+
+void BeamStats::aboveThreshold(uint16_t threshold, unsigned long nowMs,
+                               uint64_t out[BEAMSTATS_DEVICES]) const {
+  for (int d = 0; d < BEAMSTATS_DEVICES; d++) {
+    out[d] = 0;
+    for (int i = 0; i < BEAMSTATS_INPUTS; i++)
+      if (flickerPerMin(d, i, nowMs) > threshold)
+        out[d] |= 1ULL << i;
+  }
+}
+
+// {"windowMs":..,"device1":{"flickerPerMin":[48],"dropouts":[48]},...}
+void BeamStats::writeJSON(Print &out, unsigned long nowMs) const {
+  out.printf("{\"windowMs\":%lu", (unsigned long)BEAMSTATS_WINDOW_MS);
+  for (int d = 0; d < BEAMSTATS_DEVICES; d++) {
+    out.printf(",\"device%d\":{\"flickerPerMin\":[", d + 1);
+    for (int i = 0; i < BEAMSTATS_INPUTS; i++)
+      out.printf(i ? ",%u" : "%u", flickerPerMin(d, i, nowMs));
+    out.print("],\"dropouts\":[");
+    for (int i = 0; i < BEAMSTATS_INPUTS; i++)
+      out.printf(i ? ",%lu" : "%lu", (unsigned long)dropouts[d][i]);
+    out.print("]}");
+  }
+  out.print('}');
+}
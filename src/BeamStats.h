@@ -0,0 +1,45 @@
+#ifndef BEAMSTATS_H
+#define BEAMSTATS_H
+
+#include "ScanWindow.h"
+#include <Arduino.h>
+
+#define BEAMSTATS_DEVICES 4
+#define BEAMSTATS_INPUTS 48
+
+#ifndef BEAMSTATS_WINDOW_MS
+#define BEAMSTATS_WINDOW_MS 60000 // 闪烁率统计窗口
+#endif
+
+// 逐光束闪烁统计：状态翻转次数 (按分钟折算) 和掉光 (1 -> 0) 累计次数。
+// 所有扫描 (监测、基线、后台) 都会写入，用于在 Web 页面上找出噪声光束。
+class BeamStats {
+private:
+  uint64_t prev[BEAMSTATS_DEVICES];
+  uint8_t prevValid; // bit d：prev[d] 有效
+  uint16_t current[BEAMSTATS_DEVICES][BEAMSTATS_INPUTS];    // 当前窗口翻转次数
+  uint16_t lastWindow[BEAMSTATS_DEVICES][BEAMSTATS_INPUTS]; // 上一个完整窗口
+  uint32_t dropouts[BEAMSTATS_DEVICES][BEAMSTATS_INPUTS];
+  unsigned long windowStart;
+  bool haveLastWindow;
+
+public:
+  BeamStats() { reset(0); }
+
+  void reset(unsigned long nowMs);
+  // 翻转位用 CTZ 逐个累加，代价与本轮翻转数成正比
+  void update(const PackedScan &scan);
+  // 上一个完整窗口的翻转次数/分钟；首个窗口未满时按已过时间外推
+  uint16_t flickerPerMin(int device, int input, unsigned long nowMs) const;
+  uint32_t getDropouts(int device, int input) const {
+    return dropouts[device][input];
+  }
+  // 翻转率 > threshold 的光束置位
+  void aboveThreshold(uint16_t threshold, unsigned long nowMs,
+                      uint64_t out[BEAMSTATS_DEVICES]) const;
+  void writeJSON(Print &out, unsigned long nowMs) const;
+};
+
+extern BeamStats beamStats;
+
+#endif
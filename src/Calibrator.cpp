@@ -0,0 +1,129 @@
+#include "Calibrator.h"
+#include <cstring>
+
+Calibrator calibrator;
+
+static const uint8_t CAL_K[CAL_CANDIDATES] = {1, 2, 3, 4, 6, 8};
+
+// 窗口与默认配置 (60/90ms) 同比例：n = k + k/2
+static uint8_t candidateWindow(int c) { return CAL_K[c] + CAL_K[c] / 2; }
+
+Calibrator::Calibrator() : state(CAL_IDLE), periodUs(0), applyError(nullptr) {
+  memset(&result, 0, sizeof(result));
+}
+
+bool Calibrator::start(uint16_t minutes, unsigned long nowMs) {
+  if (minutes < 1 || minutes > CAL_MAX_MINUTES)
+    return false;
+  state = CAL_RUNNING;
+  startMs = nowMs;
+  durationMs = (unsigned long)minutes * 60000UL;
+  scans = 0;
+  memset(prevCount, 0, sizeof(prevCount));
+  memset(crossings, 0, sizeof(crossings));
+  memset(noiseHist, 0, sizeof(noiseHist));
+  applyError = nullptr;
+  return true;
+}
+
+bool Calibrator::observe(const DebounceEngine &debounce,
+                         const uint64_t missing[CAL_DEVICES],
+                         const bool valid[CAL_DEVICES], unsigned long nowMs) {
+  if (state != CAL_RUNNING)
+    return false;
+
+  scans++;
+  for (int d = 0; d < CAL_DEVICES; d++) {
+    if (!valid[d])
+      continue;
+    int raw = __builtin_popcountll(missing[d]);
+    noiseHist[d][raw < CAL_HIST_BUCKETS - 1 ? raw : CAL_HIST_BUCKETS - 1]++;
+
+    for (int c = 0; c < CAL_CANDIDATES; c++) {
+      int count = __builtin_popcountll(
+          debounce.evaluate(d, candidateWindow(c), CAL_K[c]));
+      if (count > CAL_MAX_TOLERANCE)
+        count = CAL_MAX_TOLERANCE;
+      // 确认缺失数从 prev 升到 count：容差 prev+1..count 各产生一次误触发
+      for (int t = prevCount[c][d] + 1; t <= count; t++)
+        crossings[c][d][t]++;
+      prevCount[c][d] = count;
+    }
+  }
+
+  if (nowMs - startMs < durationMs)
+    return false;
+  finish(nowMs, debounce.getScanPeriodUs());
+  return true;
+}
+
+// 优先最小容差 (灵敏度)，同一容差下取最短去抖 (延迟)；
+// 按每小时误触发率与目标比较，不把允许次数截断为整数 (否则短于 1 小时的校准目标失效)
+void Calibrator::finish(unsigned long nowMs, uint32_t scanPeriodUs) {
+  unsigned long elapsedMs = nowMs - startMs;
+  float hours = (elapsedMs > 0 ? elapsedMs : 1) / 3600000.0f;
+  periodUs = scanPeriodUs;
+  // 扫描周期很长 (如设备超时) 时，换算后超过 DEBOUNCE_MAX_WINDOW_MS 的候选无法配置，不参与选择
+  int usable = CAL_CANDIDATES;
+  while (usable > 1 && (uint32_t)candidateWindow(usable - 1) * periodUs / 1000 >
+                           DEBOUNCE_MAX_WINDOW_MS)
+    usable--;
+  for (int d = 0; d < CAL_DEVICES; d++) {
+    int bestT = CAL_MAX_TOLERANCE, bestC = usable - 1;
+    bool met = false;
+    for (int t = 1; t <= CAL_MAX_TOLERANCE && !met; t++) {
+      for (int c = 0; c < usable; c++) {
+        if (crossings[c][d][t] / hours <= CALIBRATION_TARGET_PER_HOUR) {
+          bestT = t;
+          bestC = c;
+          met = true;
+          break;
+        }
+      }
+    }
+    result.tolerance[d] = bestT;
+    // 向下取整，按同一扫描周期换算回去恰好是 k、n 次扫描；
+    // 最短候选仍超限时截断到上限，保证结果总能通过 validateDetectionConfig
+    uint32_t missingMs = (uint32_t)CAL_K[bestC] * periodUs / 1000;
+    uint32_t windowMs = (uint32_t)candidateWindow(bestC) * periodUs / 1000;
+    if (windowMs > DEBOUNCE_MAX_WINDOW_MS)
+      windowMs = DEBOUNCE_MAX_WINDOW_MS;
+    if (missingMs > windowMs)
+      missingMs = windowMs;
+    if (missingMs < 1)
+      missingMs = windowMs = 1;
+    result.missingMs[d] = missingMs;
+    result.windowMs[d] = windowMs;
+    result.met[d] = met;
+  }
+  state = CAL_DONE;
+}
+
+void Calibrator::writeJSON(Print &out, unsigned long nowMs) const {
+  static const char *STATE_NAMES[] = {"idle", "running", "done"};
+  unsigned long elapsed = state == CAL_RUNNING ? nowMs - startMs : 0;
+  out.printf("{\"state\":\"%s\",\"elapsedMs\":%lu,\"durationMs\":%lu,"
+             "\"scans\":%lu,\"targetPerHour\":%.2f,\"devices\":[",
+             STATE_NAMES[state], elapsed,
+             state == CAL_IDLE ? 0UL : durationMs, (unsigned long)scans,
+             (double)CALIBRATION_TARGET_PER_HOUR);
+  for (int d = 0; d < CAL_DEVICES; d++) {
+    out.printf("%s{\"device\":%d,\"noise\":[", d ? "," : "", d + 1);
+    for (int b = 0; b < CAL_HIST_BUCKETS; b++)
+      out.printf(b ? ",%lu" : "%lu", (unsigned long)noiseHist[d][b]);
+    out.print(']');
+    if (state == CAL_DONE)
+      out.printf(",\"tolerance\":%u,\"windowMs\":%u,\"missingMs\":%u,"
+                 "\"met\":%s",
+                 result.tolerance[d], result.windowMs[d], result.missingMs[d],
+                 result.met[d] ? "true" : "false");
+    out.print('}');
+  }
+  out.print(']');
+  if (state == CAL_DONE) {
+    out.printf(",\"applied\":%s", applyError ? "false" : "true");
+    if (applyError)
+      out.printf(",\"error\":\"%s\"", applyError);
+  }
+  out.print('}');
+}
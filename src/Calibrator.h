@@ -0,0 +1,64 @@
+#ifndef CALIBRATOR_H
+#define CALIBRATOR_H
+
+#include "DebounceEngine.h"
+#include <Arduino.h>
+
+#define CAL_DEVICES DEBOUNCE_DEVICES
+#define CAL_CANDIDATES 6     // 候选去抖 k = 1,2,3,4,6,8 次扫描
+#define CAL_MAX_TOLERANCE 8  // 候选容差 1..8
+#define CAL_HIST_BUCKETS 9   // 噪声分布：每轮缺失 0..7 路，最后一桶为 >= 8
+#define CAL_MAX_MINUTES 60
+
+#ifndef CALIBRATION_TARGET_PER_HOUR
+#define CALIBRATION_TARGET_PER_HOUR 1.0f // 目标误触发率 (次/小时)
+#endif
+
+// 校准得到的每设备参数
+struct CalibrationResult {
+  uint8_t tolerance[CAL_DEVICES];
+  uint16_t windowMs[CAL_DEVICES];
+  uint16_t missingMs[CAL_DEVICES];
+  bool met[CAL_DEVICES]; // false：候选中没有满足目标的组合，取了最保守的一组
+};
+
+enum CalibrationState : uint8_t { CAL_IDLE, CAL_RUNNING, CAL_DONE };
+
+// 校准模式：在无遮挡的情况下记录若干分钟扫描，统计每台设备的噪声分布，
+// 并对每组候选 (容差, k-of-n 去抖) 统计会产生的误触发次数 (确认缺失数向上穿越容差)。
+// 结束时为每台设备选出满足目标误触发率的最小容差，其次最短去抖。
+// 候选去抖直接对 DebounceEngine 的历史重新统计，不影响正常检测。
+class Calibrator {
+private:
+  CalibrationState state;
+  unsigned long startMs;
+  unsigned long durationMs;
+  uint32_t scans;
+  uint8_t prevCount[CAL_CANDIDATES][CAL_DEVICES];
+  uint32_t crossings[CAL_CANDIDATES][CAL_DEVICES][CAL_MAX_TOLERANCE + 1];
+  uint32_t noiseHist[CAL_DEVICES][CAL_HIST_BUCKETS];
+  uint32_t periodUs;
+  CalibrationResult result;
+  const char *applyError; // 结果未能生效的原因，nullptr = 已排队生效
+
+  void finish(unsigned long nowMs, uint32_t scanPeriodUs);
+
+public:
+  Calibrator();
+
+  bool start(uint16_t minutes, unsigned long nowMs);
+  void cancel() { state = CAL_IDLE; }
+  bool isRunning() const { return state == CAL_RUNNING; }
+  // 每轮监测扫描在去抖更新之后调用；校准刚完成时返回 true
+  bool observe(const DebounceEngine &debounce,
+               const uint64_t missing[CAL_DEVICES],
+               const bool valid[CAL_DEVICES], unsigned long nowMs);
+  const CalibrationResult &getResult() const { return result; }
+  // 记录结果排队生效的结论，随状态一起报告
+  void setApplyError(const char *error) { applyError = error; }
+  void writeJSON(Print &out, unsigned long nowMs) const;
+};
+
+extern Calibrator calibrator;
+
+#endif
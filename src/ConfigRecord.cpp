@@ -0,0 +1,81 @@
+#include "ConfigRecord.h"
+#include "Metrics.h"
+#include <cstddef>
+#include <cstring>
+
+ConfigJournal configJournal;
+
+void packShielding(const uint8_t shielding[4][48],
+                   uint8_t packed[CONFIG_SHIELD_BYTES]) {
+  memset(packed, 0, CONFIG_SHIELD_BYTES);
+  for (int d = 0; d < 4; d++)
+    for (int i = 0; i < 48; i++)
+      if (shielding[d][i])
+        packed[(d * 48 + i) >> 3] |= 1 << ((d * 48 + i) & 7);
+}
+
+void unpackShielding(const uint8_t packed[CONFIG_SHIELD_BYTES],
+                     uint8_t shielding[4][48]) {
+  for (int d = 0; d < 4; d++)
+    for (int i = 0; i < 48; i++)
+      shielding[d][i] = (packed[(d * 48 + i) >> 3] >> ((d * 48 + i) & 7)) & 1;
+}
+
+// CRC-32 (IEEE 802.3，反射多项式 0xEDB88320)，记录很小，逐位计算即可
+uint32_t crc32(const void *data, size_t length) {
+  const uint8_t *p = (const uint8_t *)data;
+  uint32_t crc = 0xFFFFFFFF;
+  for (size_t n = 0; n < length; n++) {
+    crc ^= p[n];
+    for (int j = 0; j < 8; j++)
+      crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+  }
+  return ~crc;
+}
+
+void sealConfigRecord(ConfigRecord &record) {
+  record.version = CONFIG_RECORD_VERSION;
+  record.size = sizeof(ConfigRecord);
+  record.crc = crc32(&record, offsetof(ConfigRecord, crc));
+}
+
+bool verifyConfigRecord(const ConfigRecord &record) {
+  return record.version == CONFIG_RECORD_VERSION &&
+         record.size == sizeof(ConfigRecord) &&
+         record.crc == crc32(&record, offsetof(ConfigRecord, crc)) &&
+         record.zoneCount <= MAX_ZONES &&
+         validateDetectionConfig(record.detection) == nullptr;
+}
+
+bool verifyConfigRecordV1(const ConfigRecordV1 &record) {
+  return record.version == 1 && record.size == sizeof(ConfigRecordV1) &&
+         record.crc == crc32(&record, offsetof(ConfigRecordV1, crc)) &&
+         validateDetectionConfig(record.detection) == nullptr;
+}
+
+ConfigJournal::ConfigJournal()
+    : dirty(0), flushRequested(false), firstEditMs(0), lastEditMs(0) {}
+
+void ConfigJournal::markDirty(uint8_t what, unsigned long nowMs) {
+  if (dirty == 0)
+    firstEditMs = nowMs;
+  dirty |= what;
+  lastEditMs = nowMs;
+  metrics.configEdits.inc();
+}
+
+bool ConfigJournal::due(unsigned long nowMs) const {
+  if (dirty == 0)
+    return false;
+  return flushRequested || nowMs - lastEditMs >= CONFIG_QUIET_MS ||
+         nowMs - firstEditMs >= CONFIG_MAX_DEFER_MS;
+}
+
+uint8_t ConfigJournal::take() {
+  uint8_t what = dirty;
+  dirty = 0;
+  flushRequested = false;
+  if (what)
+    metrics.configCommits.inc();
+  return what;
+}
@@ -0,0 +1,81 @@
+#ifndef CONFIGRECORD_H
+#define CONFIGRECORD_H
+
+#include "DetectionConfig.h"
+#include "Zones.h"
+#include <Arduino.h>
+
+#define CONFIG_RECORD_VERSION 2 // 2: 分区表并入记录
+#define CONFIG_SHIELD_BYTES 24 // 4 x 48 路屏蔽状态按位存放
+
+#ifndef CONFIG_QUIET_MS
+#define CONFIG_QUIET_MS 3000 // 最后一次修改后静默这么久再写 Flash
+#endif
+#ifndef CONFIG_MAX_DEFER_MS
+#define CONFIG_MAX_DEFER_MS 30000 // 持续修改时最长推迟，避免一直不落盘
+#endif
+
+// 全部持久化配置合为一条记录：一次写入、整体校验，版本或 CRC 不符即视为无效
+struct ConfigRecord {
+  uint16_t version; // CONFIG_RECORD_VERSION
+  uint16_t size;    // sizeof(ConfigRecord)，结构变化时同样拒绝加载
+  uint32_t sequence; // 每次提交递增
+  uint8_t shielding[CONFIG_SHIELD_BYTES]; // bit (d*48+i) = 设备 d+1 输入 i+1
+  int32_t triggerFilterThreshold;
+  DetectionConfig detection;
+  uint8_t zoneCount;
+  Zone zones[MAX_ZONES]; // 仅前 zoneCount 项有效，其余清零
+  uint32_t crc; // CRC-32，覆盖此前全部字节
+};
+
+// 版本 1 的记录 (分区表另存于 "zones" 命名空间)，只用于升级时迁移
+struct ConfigRecordV1 {
+  uint16_t version;
+  uint16_t size;
+  uint32_t sequence;
+  uint8_t shielding[CONFIG_SHIELD_BYTES];
+  int32_t triggerFilterThreshold;
+  DetectionConfig detection;
+  uint32_t crc;
+};
+
+void packShielding(const uint8_t shielding[4][48],
+                   uint8_t packed[CONFIG_SHIELD_BYTES]);
+void unpackShielding(const uint8_t packed[CONFIG_SHIELD_BYTES],
+                     uint8_t shielding[4][48]);
+uint32_t crc32(const void *data, size_t length);
+void sealConfigRecord(ConfigRecord &record);
+bool verifyConfigRecord(const ConfigRecord &record);
+bool verifyConfigRecordV1(const ConfigRecordV1 &record);
+
+// 需要写入 Flash 的内容
+enum ConfigDirty : uint8_t {
+  CONFIG_DIRTY_RECORD = 1,   // ConfigRecord (含分区表)
+  CONFIG_DIRTY_SNAPSHOT = 2, // 基线快照 (屏蔽变化后计数和哈希随之改变)
+  CONFIG_DIRTY_PROFILES = 4, // 配置方案及当前启用的方案
+};
+
+// 写回日志：修改只在内存中生效并标记，静默 CONFIG_QUIET_MS 后 (或收到立即保存请求)
+// 由主循环合并为一次提交，把 NVS 写入 (约 10ms) 移出请求和扫描路径，减少 Flash 磨损
+class ConfigJournal {
+private:
+  uint8_t dirty;
+  bool flushRequested;
+  unsigned long firstEditMs;
+  unsigned long lastEditMs;
+
+public:
+  ConfigJournal();
+
+  void markDirty(uint8_t what, unsigned long nowMs);
+  void discard(uint8_t what) { dirty &= ~what; }
+  void requestFlush() { flushRequested = dirty != 0; }
+  bool due(unsigned long nowMs) const;
+  // 取出待写内容并清除标记，由调用方完成写入
+  uint8_t take();
+  uint8_t getDirty() const { return dirty; }
+};
+
+extern ConfigJournal configJournal;
+
+#endif
@@ -0,0 +1,145 @@
+#include "DebounceEngine.h"
+#include <cstring>
+
+DebounceEngine::DebounceEngine()
+    : periodUs(DEBOUNCE_DEFAULT_PERIOD_US), lastScanUs(0), havePeriod(false) {
+  for (int d = 0; d < DEBOUNCE_DEVICES; d++) {
+    windowMs[d] = 0;
+    minMissingMs[d] = 0;
+    windowScans[d] = 1;
+    minScans[d] = 1;
+  }
+  reset();
+}
+
+void DebounceEngine::configure(int device, uint16_t window, uint16_t minMissing) {
+  if (device < 0 || device >= DEBOUNCE_DEVICES)
+    return;
+  windowMs[device] = window;
+  minMissingMs[device] = minMissing;
+  applyThresholds(device);
+}
+
+void DebounceEngine::reset() {
+  memset(history, 0, sizeof(history));
+  memset(head, 0, sizeof(head));
+  memset(filled, 0, sizeof(filled));
+  memset(counters, 0, sizeof(counters));
+}
+
+uint8_t DebounceEngine::scansFor(uint16_t ms) const {
+  uint32_t scans = ((uint32_t)ms * 1000 + periodUs - 1) / periodUs;
+  if (scans < 1)
+    return 1;
+  return scans > DEBOUNCE_MAX_HISTORY ? DEBOUNCE_MAX_HISTORY : scans;
+}
+
+// 时间阈值向上取整换算为扫描次数：k = ceil(minMissing / T)，n = max(k, ceil(window / T))
+void DebounceEngine::applyThresholds(int device) {
+  uint8_t k = scansFor(minMissingMs[device]);
+  uint8_t n = scansFor(windowMs[device]);
+  if (n < k)
+    n = k;
+  minScans[device] = k;
+  if (n != windowScans[device]) {
+    windowScans[device] = n;
+    recount(device);
+  }
+}
+
+// 窗口长度变化后按最近 n 个历史平面重建计数器
+void DebounceEngine::recount(int device) {
+  sumHistory(device, windowScans[device], counters[device]);
+}
+
+// 把最近 n 个历史平面逐一加到位切片计数器 c
+void DebounceEngine::sumHistory(int device, uint8_t n, uint64_t *c) const {
+  memset(c, 0, sizeof(uint64_t) * DEBOUNCE_COUNTER_BITS);
+  uint8_t count = filled[device] < n ? filled[device] : n;
+  for (uint8_t age = 1; age <= count; age++) {
+    uint64_t carry =
+        history[device][(head[device] + DEBOUNCE_MAX_HISTORY - age) %
+                        DEBOUNCE_MAX_HISTORY];
+    for (int j = 0; j < DEBOUNCE_COUNTER_BITS && carry; j++) {
+      uint64_t next = c[j] & carry;
+      c[j] ^= carry;
+      carry = next;
+    }
+  }
+}
+
+// 逐位计算 count - k 的借位，借位为 1 即 count < k
+uint64_t DebounceEngine::atLeast(const uint64_t *c, uint8_t k) {
+  uint64_t lt = 0;
+  for (int j = 0; j < DEBOUNCE_COUNTER_BITS; j++) {
+    uint64_t a = c[j];
+    uint64_t b = ((k >> j) & 1) ? ~0ULL : 0;
+    lt = (~a & (b | lt)) | (a & b & lt);
+  }
+  return ~lt & 0xFFFFFFFFFFFFULL;
+}
+
+void DebounceEngine::beginScan(unsigned long nowUs) {
+  if (lastScanUs != 0) {
+    uint32_t delta = nowUs - lastScanUs;
+    // 超过 1 秒的间隔说明监测曾暂停，不计入扫描周期
+    if (delta > 0 && delta < 1000000) {
+      if (!havePeriod) {
+        periodUs = delta;
+        havePeriod = true;
+      } else {
+        periodUs = (uint32_t)((int32_t)periodUs +
+                              ((int32_t)delta - (int32_t)periodUs) / 8);
+      }
+      if (periodUs == 0)
+        periodUs = 1;
+      for (int d = 0; d < DEBOUNCE_DEVICES; d++)
+        applyThresholds(d);
+    }
+  }
+  lastScanUs = nowUs;
+}
+
+uint64_t DebounceEngine::update(int device, uint64_t missing) {
+  uint64_t *c = counters[device];
+  uint8_t n = windowScans[device];
+
+  // 新平面加一
+  uint64_t carry = missing;
+  for (int j = 0; j < DEBOUNCE_COUNTER_BITS && carry; j++) {
+    uint64_t next = c[j] & carry;
+    c[j] ^= carry;
+    carry = next;
+  }
+  // 滑出窗口的平面减一
+  if (filled[device] >= n) {
+    uint64_t borrow =
+        history[device][(head[device] + DEBOUNCE_MAX_HISTORY - n) %
+                        DEBOUNCE_MAX_HISTORY];
+    for (int j = 0; j < DEBOUNCE_COUNTER_BITS && borrow; j++) {
+      uint64_t next = ~c[j] & borrow;
+      c[j] ^= borrow;
+      borrow = next;
+    }
+  }
+
+  history[device][head[device]] = missing;
+  head[device] = (head[device] + 1) % DEBOUNCE_MAX_HISTORY;
+  if (filled[device] < DEBOUNCE_MAX_HISTORY)
+    filled[device]++;
+
+  return atLeast(c, minScans[device]);
+}
+
+uint64_t DebounceEngine::evaluate(int device, uint8_t n, uint8_t k) const {
+  uint64_t c[DEBOUNCE_COUNTER_BITS];
+  sumHistory(device, n, c);
+  return atLeast(c, k);
+}
+
+bool DebounceEngine::pending(int device) const {
+  uint64_t any = 0;
+  for (int j = 0; j < DEBOUNCE_COUNTER_BITS; j++)
+    any |= counters[device][j];
+  return any != 0;
+}
@@ -0,0 +1,72 @@
+#ifndef DEBOUNCEENGINE_H
+#define DEBOUNCEENGINE_H
+
+#include <Arduino.h>
+
+// 每路光束保留的最大历史扫描次数 (n 的上限)
+#ifndef DEBOUNCE_MAX_HISTORY
+#define DEBOUNCE_MAX_HISTORY 32
+#endif
+// 尚未测得扫描周期时使用的默认值
+#ifndef DEBOUNCE_DEFAULT_PERIOD_US
+#define DEBOUNCE_DEFAULT_PERIOD_US 30000
+#endif
+
+// 可配置的去抖窗口上限：DEBOUNCE_MAX_HISTORY 次扫描按标称周期换算 (32 × 30ms = 960ms)，
+// 更长的窗口会被 scansFor() 截断为 DEBOUNCE_MAX_HISTORY，配置时直接拒绝
+#define DEBOUNCE_MAX_WINDOW_MS                                                 \
+  (DEBOUNCE_MAX_HISTORY * (DEBOUNCE_DEFAULT_PERIOD_US / 1000))
+
+#define DEBOUNCE_DEVICES 4
+#define DEBOUNCE_COUNTER_BITS 6 // 位切片计数器位数，需能表示 DEBOUNCE_MAX_HISTORY
+
+// 逐光束滑动窗口 k-of-n 去抖：
+// 每台设备保存最近 n 次扫描的缺失掩码 (每次一个 uint64_t 位平面)，
+// 并用位切片计数器整字并行维护每路光束在窗口内的缺失次数，
+// 窗口内缺失 >= k 次的光束视为已确认缺失。
+// n、k 由时间阈值 (ms) 按实测扫描周期换算，扫描速率变化时行为保持一致。
+class DebounceEngine {
+private:
+  uint64_t history[DEBOUNCE_DEVICES][DEBOUNCE_MAX_HISTORY];
+  uint8_t head[DEBOUNCE_DEVICES];   // 下一个写入位置
+  uint8_t filled[DEBOUNCE_DEVICES]; // 已写入的历史数 (<= DEBOUNCE_MAX_HISTORY)
+  uint64_t counters[DEBOUNCE_DEVICES][DEBOUNCE_COUNTER_BITS];
+
+  uint16_t windowMs[DEBOUNCE_DEVICES];
+  uint16_t minMissingMs[DEBOUNCE_DEVICES];
+  uint8_t windowScans[DEBOUNCE_DEVICES]; // n
+  uint8_t minScans[DEBOUNCE_DEVICES];    // k
+
+  uint32_t periodUs; // 扫描周期 EWMA (1/8)
+  unsigned long lastScanUs;
+  bool havePeriod;
+
+  void recount(int device);
+  void sumHistory(int device, uint8_t n, uint64_t *c) const;
+  static uint64_t atLeast(const uint64_t *c, uint8_t k);
+  void applyThresholds(int device);
+
+public:
+  DebounceEngine();
+
+  // windowMs：窗口长度；minMissingMs：窗口内累计缺失时长达到该值才确认
+  void configure(int device, uint16_t windowMs, uint16_t minMissingMs);
+  // 清空历史 (重新建立基线时)
+  void reset();
+  // 每轮扫描调用一次，更新扫描周期并按需重新换算 n、k
+  void beginScan(unsigned long nowUs);
+  // 写入设备本次扫描的缺失掩码，返回窗口内缺失 >= k 次的光束
+  uint64_t update(int device, uint64_t missing);
+  // 窗口内是否还有任何缺失记录
+  bool pending(int device) const;
+  // 用任意 n、k 对历史重新统计 (供分区规则使用，不影响设备自身的计数器)
+  uint64_t evaluate(int device, uint8_t n, uint8_t k) const;
+  // 时长按当前扫描周期向上取整为扫描次数 (1..DEBOUNCE_MAX_HISTORY)
+  uint8_t scansFor(uint16_t ms) const;
+
+  uint8_t getWindowScans(int device) const { return windowScans[device]; }
+  uint8_t getMinScans(int device) const { return minScans[device]; }
+  uint32_t getScanPeriodUs() const { return periodUs; }
+};
+
+#endif
@@ -0,0 +1,155 @@
+#include "DetectionConfig.h"
+#include "DebounceEngine.h"
+#include <ArduinoJson.h>
+#include <cstring>
+
+DetectionConfigStore detectionConfig;
+
+#define DETECTION_MAX_SAMPLES 8 // 快速重建基线的滚动窗口长度
+
+const char *validateDetectionConfig(const DetectionConfig &config) {
+  for (int d = 0; d < DETECTION_DEVICES; d++) {
+    if (config.tolerance[d] < 1 || config.tolerance[d] > 48)
+      return "tolerance must be 1-48";
+    if (config.debounceMissingMs[d] < 1 ||
+        config.debounceMissingMs[d] > DEBOUNCE_MAX_WINDOW_MS ||
+        config.debounceWindowMs[d] > DEBOUNCE_MAX_WINDOW_MS) {
+      // 去抖历史最多保存 DEBOUNCE_MAX_HISTORY 次扫描，超出会被静默截断
+      static char error[64];
+      snprintf(error, sizeof(error), "debounce must be 1-%u ms (%u scans)",
+               (unsigned)DEBOUNCE_MAX_WINDOW_MS, (unsigned)DEBOUNCE_MAX_HISTORY);
+      return error;
+    }
+    if (config.debounceWindowMs[d] < config.debounceMissingMs[d])
+      return "debounceWindowMs must be >= debounceMissingMs";
+    if (config.minRunWidth[d] < 1 || config.minRunWidth[d] > 48)
+      return "minRunWidth must be 1-48";
+  }
+  if (config.baselineScanIntervalMs < 1 || config.backgroundScanIntervalMs < 1)
+    return "scan intervals must be >= 1 ms";
+  if (config.baselineSamples < 1 ||
+      config.baselineSamples > DETECTION_MAX_SAMPLES ||
+      config.baselineMinVotes < 1 ||
+      config.baselineMinVotes > config.baselineSamples)
+    return "need 1 <= baselineMinVotes <= baselineSamples <= 8";
+  return nullptr;
+}
+
+// 数组字段必须给全 4 个设备；超出字段类型范围视为错误而不是截断
+template <typename T>
+static bool readArray(JsonVariantConst value, T *out) {
+  if (value.isNull())
+    return true;
+  JsonArrayConst array = value.as<JsonArrayConst>();
+  if (array.isNull() || array.size() != DETECTION_DEVICES)
+    return false;
+  for (int d = 0; d < DETECTION_DEVICES; d++) {
+    if (!array[d].is<int>() || array[d].as<long>() < 0 ||
+        array[d].as<long>() > (long)(T)~(T)0)
+      return false;
+    out[d] = array[d].as<int>();
+  }
+  return true;
+}
+
+template <typename T> static bool readValue(JsonVariantConst value, T &out) {
+  if (value.isNull())
+    return true;
+  if (!value.is<int>() || value.as<long>() < 0 ||
+      value.as<long>() > (long)(T)~(T)0)
+    return false;
+  out = value.as<int>();
+  return true;
+}
+
+const char *mergeDetectionConfigJSON(const char *json, size_t length,
+                                     DetectionConfig &config) {
+  StaticJsonDocument<768> doc;
+  if (deserializeJson(doc, json, length) != DeserializationError::Ok ||
+      !doc.is<JsonObject>())
+    return "invalid JSON";
+
+  DetectionConfig merged = config;
+  if (!readArray(doc["tolerance"], merged.tolerance) ||
+      !readArray(doc["debounceWindowMs"], merged.debounceWindowMs) ||
+      !readArray(doc["debounceMissingMs"], merged.debounceMissingMs) ||
+      !readArray(doc["minRunWidth"], merged.minRunWidth) ||
+      !readValue(doc["baselineDelayMs"], merged.baselineDelayMs) ||
+      !readValue(doc["baselineScanIntervalMs"], merged.baselineScanIntervalMs) ||
+      !readValue(doc["backgroundScanIntervalMs"],
+                 merged.backgroundScanIntervalMs) ||
+      !readValue(doc["baselineSamples"], merged.baselineSamples) ||
+      !readValue(doc["baselineMinVotes"], merged.baselineMinVotes))
+    return "field has wrong type or size";
+
+  const char *error = validateDetectionConfig(merged);
+  if (error)
+    return error;
+  config = merged;
+  return nullptr;
+}
+
+template <typename T>
+static void printArray(Print &out, const char *name, const T *values) {
+  out.printf(",\"%s\":[%u,%u,%u,%u]", name, (unsigned)values[0],
+             (unsigned)values[1], (unsigned)values[2], (unsigned)values[3]);
+}
+
+void writeDetectionConfigJSON(Print &out, const DetectionConfig &config,
+                              bool pending) {
+  out.printf("{\"version\":%u,\"revision\":%lu,\"pending\":%s", config.version,
+             (unsigned long)config.revision, pending ? "true" : "false");
+  printArray(out, "tolerance", config.tolerance);
+  printArray(out, "debounceWindowMs", config.debounceWindowMs);
+  printArray(out, "debounceMissingMs", config.debounceMissingMs);
+  printArray(out, "minRunWidth", config.minRunWidth);
+  out.printf(",\"baselineDelayMs\":%u,\"baselineScanIntervalMs\":%u,"
+             "\"backgroundScanIntervalMs\":%u,\"baselineSamples\":%u,"
+             "\"baselineMinVotes\":%u}",
+             config.baselineDelayMs, config.baselineScanIntervalMs,
+             config.backgroundScanIntervalMs, config.baselineSamples,
+             config.baselineMinVotes);
+}
+
+DetectionConfigStore::DetectionConfigStore() : active(&slots[0]), pending(nullptr) {
+  memset(slots, 0, sizeof(slots));
+}
+
+void DetectionConfigStore::begin(const DetectionConfig &initial) {
+  slots[0] = initial;
+  slots[0].version = DETECTION_CONFIG_VERSION;
+  pending.store(nullptr);
+  active.store(&slots[0]);
+}
+
+const DetectionConfig &DetectionConfigStore::latest() const {
+  DetectionConfig *next = pending.load();
+  return next ? *next : *active.load();
+}
+
+const char *DetectionConfigStore::stage(const DetectionConfig &config) {
+  const char *error = validateDetectionConfig(config);
+  if (error)
+    return error;
+
+  // 既不是当前生效、也不是排队中的槽位可以安全改写
+  DetectionConfig *current = active.load();
+  DetectionConfig *queued = pending.load();
+  DetectionConfig *slot = &slots[0];
+  while (slot == current || slot == queued)
+    slot++;
+
+  uint32_t revision = latest().revision + 1;
+  *slot = config;
+  slot->version = DETECTION_CONFIG_VERSION;
+  slot->revision = revision;
+  pending.store(slot);
+  return nullptr;
+}
+
+const DetectionConfig *DetectionConfigStore::commit() {
+  DetectionConfig *next = pending.exchange(nullptr);
+  if (next == nullptr)
+    return nullptr;
+  return active.exchange(next);
+}
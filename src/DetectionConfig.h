@@ -0,0 +1,58 @@
+#ifndef DETECTIONCONFIG_H
+#define DETECTIONCONFIG_H
+
+#include <Arduino.h>
+#include <atomic>
+
+#define DETECTION_CONFIG_VERSION 1 // 结构变化时递增，旧版本的 Flash 数据不再加载
+#define DETECTION_DEVICES 4
+
+// 全部可在线修改的检测参数，作为一个整体加载、校验、保存和切换
+struct DetectionConfig {
+  uint16_t version;  // DETECTION_CONFIG_VERSION
+  uint32_t revision; // 每次修改递增，日志与 /api/config 据此确认生效的版本
+  uint8_t tolerance[DETECTION_DEVICES];
+  uint16_t debounceWindowMs[DETECTION_DEVICES];
+  uint16_t debounceMissingMs[DETECTION_DEVICES];
+  uint8_t minRunWidth[DETECTION_DEVICES];
+  uint16_t baselineDelayMs;
+  uint16_t baselineScanIntervalMs;
+  uint16_t backgroundScanIntervalMs;
+  uint8_t baselineSamples;
+  uint8_t baselineMinVotes;
+};
+
+// 范围检查，失败时返回错误说明，合法返回 nullptr
+const char *validateDetectionConfig(const DetectionConfig &config);
+// 把 JSON 中出现的字段合并到 config (部分更新)，随后整体校验
+const char *mergeDetectionConfigJSON(const char *json, size_t length,
+                                     DetectionConfig &config);
+void writeDetectionConfigJSON(Print &out, const DetectionConfig &config,
+                              bool pending);
+
+// 三个槽位轮换：REST/MQTT 写入空闲槽后发布为 pending，检测循环在扫描边界
+// 以一次指针交换使其生效，单轮扫描内看到的始终是同一份完整配置
+class DetectionConfigStore {
+private:
+  DetectionConfig slots[3];
+  std::atomic<DetectionConfig *> active;
+  std::atomic<DetectionConfig *> pending;
+
+public:
+  DetectionConfigStore();
+
+  void begin(const DetectionConfig &initial);
+  const DetectionConfig &current() const { return *active.load(); }
+  // 尚未生效的修改也计入，连续编辑不会互相覆盖
+  const DetectionConfig &latest() const;
+  bool hasPending() const { return pending.load() != nullptr; }
+  // 校验通过后分配新的 revision 并排队，返回错误说明或 nullptr
+  const char *stage(const DetectionConfig &config);
+  // 扫描边界调用：有待生效配置时切换并返回切换前的配置 (下一次 stage 前有效)，
+  // 否则返回 nullptr
+  const DetectionConfig *commit();
+};
+
+extern DetectionConfigStore detectionConfig;
+
+#endif
@@ -0,0 +1,171 @@
+#include "Metrics.h"
+
+// 单次 Modbus 往返 (请求发出到 CRC 校验完成)，115200 波特率下约 2ms
+static const uint32_t RTT_BUCKETS_US[] = {1500, 2000, 2500,  3000,  4000,
+                                          5000, 7500, 10000, 20000, 50000};
+
+// 触发延迟：去抖至少 2 轮扫描，每轮 4 台设备约 20ms
+static const uint32_t TRIGGER_BUCKETS_US[] = {
+    5000, 10000, 20000, 40000, 60000, 80000, 100000, 150000, 250000, 1000000};
+
+MetricsRegistry metrics;
+
+Histogram::Histogram(const uint32_t *bounds, uint8_t boundCount)
+    : bounds(bounds),
+      boundCount(boundCount > METRICS_MAX_BUCKETS ? METRICS_MAX_BUCKETS
+                                                  : boundCount),
+      count(0), sumLow(0), sumHigh(0) {
+  for (int i = 0; i <= METRICS_MAX_BUCKETS; i++)
+    buckets[i].store(0, std::memory_order_relaxed);
+}
+
+void Histogram::observe(uint32_t value) {
+  uint8_t i = 0;
+  while (i < boundCount && value > bounds[i])
+    i++;
+  buckets[i].fetch_add(1, std::memory_order_relaxed);
+  count.fetch_add(1, std::memory_order_relaxed);
+  uint32_t low = sumLow.load(std::memory_order_relaxed);
+  if (low + value < low)
+    sumHigh.fetch_add(1, std::memory_order_relaxed);
+  sumLow.store(low + value, std::memory_order_relaxed);
+}
+
+uint64_t Histogram::getSum() const {
+  return ((uint64_t)sumHigh.load(std::memory_order_relaxed) << 32) |
+         sumLow.load(std::memory_order_relaxed);
+}
+
+MetricsRegistry::MetricsRegistry()
+    : deviceRtt{{RTT_BUCKETS_US, 10},
+                {RTT_BUCKETS_US, 10},
+                {RTT_BUCKETS_US, 10},
+                {RTT_BUCKETS_US, 10}},
+      triggerDetectLatency(TRIGGER_BUCKETS_US, 10),
+      triggerPublishLatency(TRIGGER_BUCKETS_US, 10),
+      triggerLatency(TRIGGER_BUCKETS_US, 10), lastTickMs(0), lastScans(0) {}
+
+void MetricsRegistry::tick(unsigned long nowMs) {
+  if (nowMs - lastTickMs < 1000)
+    return;
+  uint32_t scans = scansTotal.get();
+  scanRate.set((int32_t)((uint64_t)(scans - lastScans) * 1000 /
+                         (nowMs - lastTickMs)));
+  lastScans = scans;
+  lastTickMs = nowMs;
+}
+
+// ============== Prometheus 输出 ==============
+static void writeHeader(Print &out, const char *name, const char *help,
+                        const char *type) {
+  out.printf("# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+static void writeCounter(Print &out, const char *name, const char *help,
+                         const Counter &counter) {
+  writeHeader(out, name, help, "counter");
+  out.printf("%s %u\n", name, counter.get());
+}
+
+static void writeGauge(Print &out, const char *name, const char *help,
+                       const Gauge &gauge) {
+  writeHeader(out, name, help, "gauge");
+  out.printf("%s %d\n", name, gauge.get());
+}
+
+static void writeDeviceCounters(Print &out, const char *name, const char *help,
+                                const Counter *counters) {
+  writeHeader(out, name, help, "counter");
+  for (int d = 0; d < METRICS_NUM_DEVICES; d++)
+    out.printf("%s{device=\"%d\"} %u\n", name, d + 1, counters[d].get());
+}
+
+// labels 为空串或形如 device="1" 的标签列表
+static void writeHistogramSeries(Print &out, const char *name,
+                                 const char *labels, const Histogram &h) {
+  const char *sep = labels[0] ? "," : "";
+  uint32_t cumulative = 0;
+  for (uint8_t i = 0; i < h.getBoundCount(); i++) {
+    cumulative += h.getBucket(i);
+    out.printf("%s_bucket{%s%sle=\"%u\"} %u\n", name, labels, sep,
+               h.getBound(i), cumulative);
+  }
+  cumulative += h.getBucket(h.getBoundCount());
+  out.printf("%s_bucket{%s%sle=\"+Inf\"} %u\n", name, labels, sep, cumulative);
+  if (labels[0]) {
+    out.printf("%s_sum{%s} %llu\n", name, labels,
+               (unsigned long long)h.getSum());
+    out.printf("%s_count{%s} %u\n", name, labels, h.getCount());
+  } else {
+    out.printf("%s_sum %llu\n", name, (unsigned long long)h.getSum());
+    out.printf("%s_count %u\n", name, h.getCount());
+  }
+}
+
+static void writeHistogram(Print &out, const char *name, const char *help,
+                           const Histogram &h) {
+  writeHeader(out, name, help, "histogram");
+  writeHistogramSeries(out, name, "", h);
+}
+
+static void writeDeviceHistograms(Print &out, const char *name,
+                                  const char *help, const Histogram *hists) {
+  writeHeader(out, name, help, "histogram");
+  char labels[16];
+  for (int d = 0; d < METRICS_NUM_DEVICES; d++) {
+    snprintf(labels, sizeof(labels), "device=\"%d\"", d + 1);
+    writeHistogramSeries(out, name, labels, hists[d]);
+  }
+}
+
+void MetricsRegistry::writePrometheus(Print &out) const {
+  writeCounter(out, "laser_scans_total", "Completed detection scan cycles.",
+               scansTotal);
+  writeGauge(out, "laser_scan_rate", "Scan cycles during the last second.",
+             scanRate);
+  writeDeviceHistograms(out, "laser_device_rtt_microseconds",
+                        "Modbus request-to-validated-response time.",
+                        deviceRtt);
+  writeDeviceCounters(out, "laser_device_crc_failures_total",
+                      "Modbus responses rejected by CRC check.", crcFailures);
+  writeDeviceCounters(out, "laser_device_timeouts_total",
+                      "Modbus requests without a complete response.",
+                      timeouts);
+  writeCounter(out, "laser_triggers_total", "Confirmed triggers.", triggers);
+  writeCounter(out, "laser_triggers_filtered_total",
+               "Triggers suppressed by the false-trigger filter.",
+               filteredTriggers);
+  writeCounter(out, "laser_triggers_rate_limited_total",
+               "Triggers suppressed by the re-arm rate limit.",
+               suppressedTriggers);
+  writeGauge(out, "laser_trigger_arm_state",
+             "Device trigger re-arm state (0 armed, 1 latched, 2 clearing).",
+             triggerArmState);
+  writeHistogram(out, "laser_trigger_detect_latency_microseconds",
+                 "First scan with missing beams to debounce confirmation.",
+                 triggerDetectLatency);
+  writeHistogram(out, "laser_trigger_publish_latency_microseconds",
+                 "Debounce confirmation to MQTT publish completed.",
+                 triggerPublishLatency);
+  writeHistogram(out, "laser_trigger_latency_microseconds",
+                 "First scan with missing beams to MQTT publish completed.",
+                 triggerLatency);
+  writeCounter(out, "laser_sse_bytes_total", "Bytes pushed to SSE clients.",
+               sseBytes);
+  writeCounter(out, "laser_config_edits_total",
+               "Configuration changes recorded by the write-behind journal.",
+               configEdits);
+  writeCounter(out, "laser_config_commits_total",
+               "Journal flushes written to flash.", configCommits);
+  writeCounter(out, "laser_mqtt_reconnects_total",
+               "Successful MQTT (re)connections.", mqttReconnects);
+  writeCounter(out, "laser_mqtt_connect_failures_total",
+               "Failed MQTT connection attempts.", mqttConnectFailures);
+  writeGauge(out, "laser_heap_free_bytes", "Current free heap.", heapFree);
+  writeGauge(out, "laser_heap_min_free_bytes", "Lowest free heap since boot.",
+             heapMin);
+  writeGauge(out, "laser_loop_stack_high_water_bytes",
+             "Unused stack of the loop task.", loopStackHighWater);
+  writeGauge(out, "laser_ota_stack_high_water_bytes",
+             "Unused stack of the OTA task (0 when idle).", otaStackHighWater);
+}
@@ -0,0 +1,92 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <Arduino.h>
+#include <atomic>
+
+#define METRICS_NUM_DEVICES 4
+#define METRICS_MAX_BUCKETS 10
+
+// 所有指标均为单写者 (扫描/网络都运行在 loopTask)，
+// 读写使用 relaxed 原子操作，不加锁、不分配堆内存。
+class Counter {
+private:
+  std::atomic<uint32_t> value;
+
+public:
+  Counter() : value(0) {}
+  void inc(uint32_t n = 1) { value.fetch_add(n, std::memory_order_relaxed); }
+  uint32_t get() const { return value.load(std::memory_order_relaxed); }
+};
+
+class Gauge {
+private:
+  std::atomic<int32_t> value;
+
+public:
+  Gauge() : value(0) {}
+  void set(int32_t v) { value.store(v, std::memory_order_relaxed); }
+  int32_t get() const { return value.load(std::memory_order_relaxed); }
+};
+
+// 固定上界的累积直方图 (Prometheus 语义：bucket 计数 <= le)
+class Histogram {
+private:
+  const uint32_t *bounds;
+  uint8_t boundCount;
+  std::atomic<uint32_t> buckets[METRICS_MAX_BUCKETS + 1]; // 最后一个为 +Inf
+  std::atomic<uint32_t> count;
+  std::atomic<uint32_t> sumLow;  // sum 拆成两个 32 位，单写者下无需锁
+  std::atomic<uint32_t> sumHigh;
+
+public:
+  Histogram(const uint32_t *bounds, uint8_t boundCount);
+  void observe(uint32_t value);
+  uint8_t getBoundCount() const { return boundCount; }
+  uint32_t getBound(uint8_t i) const { return bounds[i]; }
+  uint32_t getBucket(uint8_t i) const {
+    return buckets[i].load(std::memory_order_relaxed);
+  }
+  uint32_t getCount() const { return count.load(std::memory_order_relaxed); }
+  uint64_t getSum() const;
+};
+
+struct MetricsRegistry {
+  MetricsRegistry();
+
+  Counter scansTotal;
+  Gauge scanRate;                         // 最近 1 秒的扫描次数
+  Histogram deviceRtt[METRICS_NUM_DEVICES]; // 微秒
+  Counter crcFailures[METRICS_NUM_DEVICES];
+  Counter timeouts[METRICS_NUM_DEVICES];
+  Counter triggers;
+  Counter filteredTriggers;
+  Counter suppressedTriggers; // 超过重新布防速率上限
+  Gauge triggerArmState;      // 设备级 TriggerArm：0 ARMED / 1 LATCHED / 2 CLEARING
+  // 端到端触发延迟 (微秒)：首次缺失扫描 -> 去抖确认 -> MQTT 发布完成
+  Histogram triggerDetectLatency;
+  Histogram triggerPublishLatency;
+  Histogram triggerLatency;
+  Counter sseBytes;
+  Counter configEdits;   // 写回日志收到的修改
+  Counter configCommits; // 合并后实际写入 Flash 的次数
+  Counter mqttReconnects;
+  Counter mqttConnectFailures;
+  Gauge heapFree;
+  Gauge heapMin;
+  Gauge loopStackHighWater;
+  Gauge otaStackHighWater;
+
+  // loop() 中周期调用，更新扫描速率
+  void tick(unsigned long nowMs);
+  // Prometheus 文本格式输出 (0.0.4)
+  void writePrometheus(Print &out) const;
+
+private:
+  unsigned long lastTickMs;
+  uint32_t lastScans;
+};
+
+extern MetricsRegistry metrics;
+
+#endif
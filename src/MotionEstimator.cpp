@@ -0,0 +1,125 @@
+#include "MotionEstimator.h"
+#include <cstring>
+
+MotionEstimator::MotionEstimator() {
+  for (int d = 0; d < MOTION_DEVICES; d++)
+    positionMm[d] = 0;
+  memset(&latest, 0, sizeof(latest));
+  reset();
+}
+
+void MotionEstimator::reset() {
+  memset(prevMissing, 0, sizeof(prevMissing));
+  memset(brokenBeams, 0, sizeof(brokenBeams));
+  memset(occluded, 0, sizeof(occluded));
+  memset(seen, 0, sizeof(seen));
+}
+
+bool MotionEstimator::update(int device, uint64_t missing,
+                             unsigned long prevReadUs, unsigned long readUs) {
+  uint64_t breaks = missing & ~prevMissing[device];
+  uint64_t restores = prevMissing[device] & ~missing;
+  prevMissing[device] = missing;
+  // 边沿发生在两次读取之间，取中点使误差对称
+  unsigned long edgeUs = prevReadUs + (readUs - prevReadUs) / 2;
+
+  if (!occluded[device] && missing) {
+    occluded[device] = true;
+    seen[device] = true;
+    breakUs[device] = edgeUs;
+    brokenBeams[device] = 0;
+  }
+  // 同一遮挡过程中反复断光的光束只保留首次断光，复光保留最后一次
+  for (uint64_t m = breaks & ~brokenBeams[device]; m; m &= m - 1)
+    beamBreakUs[device][__builtin_ctzll(m)] = edgeUs;
+  brokenBeams[device] |= breaks;
+  for (uint64_t m = restores; m; m &= m - 1)
+    beamRestoreUs[device][__builtin_ctzll(m)] = edgeUs;
+
+  if (occluded[device] && !missing) {
+    occluded[device] = false;
+    restoreUs[device] = edgeUs;
+    return estimate(device);
+  }
+  return false;
+}
+
+// 两台设备上同一批光束的平均通过时间 (前沿取断光，后沿取复光)；
+// 个别光束的时间差为负或超出上限时不计入，全部无效返回 0
+uint32_t MotionEstimator::beamTransit(int from, int to, uint64_t beams,
+                                      bool trailing) const {
+  uint64_t sum = 0;
+  uint32_t count = 0;
+  for (uint64_t m = beams; m; m &= m - 1) {
+    int i = __builtin_ctzll(m);
+    uint32_t delta = trailing ? beamRestoreUs[to][i] - beamRestoreUs[from][i]
+                              : beamBreakUs[to][i] - beamBreakUs[from][i];
+    if ((int32_t)delta <= 0 || delta > MOTION_MAX_TRANSIT_MS * 1000UL)
+      continue;
+    sum += delta;
+    count++;
+  }
+  return count ? (uint32_t)(sum / count) : 0;
+}
+
+// 设备通过结束时，与之前最近一次断光的其他设备配对
+bool MotionEstimator::estimate(int device) {
+  int from = -1;
+  uint32_t bestTransit = 0;
+  for (int d = 0; d < MOTION_DEVICES; d++) {
+    if (d == device || !seen[d] || positionMm[d] == positionMm[device])
+      continue;
+    uint32_t transit = breakUs[device] - breakUs[d];
+    if ((int32_t)transit <= 0 || transit > MOTION_MAX_TRANSIT_MS * 1000UL)
+      continue;
+    if (from < 0 || transit < bestTransit) {
+      from = d;
+      bestTransit = transit;
+    }
+  }
+  if (from < 0)
+    return false;
+
+  // 两台设备都断过光的同号光束逐一配对；没有共同光束时按设备整体边沿估计。
+  // 前设备也已复光时，前沿和后沿的通过时间取平均
+  uint64_t common = brokenBeams[device] & brokenBeams[from];
+  uint32_t leading = common ? beamTransit(from, device, common, false) : 0;
+  uint32_t trailing = 0;
+  if (leading == 0) {
+    common = 0;
+    leading = bestTransit;
+    if (!occluded[from])
+      trailing = restoreUs[device] - restoreUs[from];
+  } else if (!occluded[from]) {
+    trailing = beamTransit(from, device, common, true);
+  }
+  uint32_t transit = leading;
+  if ((int32_t)trailing > 0 && trailing <= MOTION_MAX_TRANSIT_MS * 1000UL)
+    transit = (uint32_t)(((uint64_t)leading + trailing) / 2);
+
+  int32_t distance = positionMm[device] - positionMm[from];
+  uint32_t occludedUs = restoreUs[device] - breakUs[device];
+  latest.fromDevice = from + 1;
+  latest.toDevice = device + 1;
+  latest.direction = distance > 0 ? 1 : -1;
+  latest.speedMmS =
+      (uint32_t)((uint64_t)(distance > 0 ? distance : -distance) * 1000000ULL /
+                 transit);
+  latest.lengthMm =
+      (uint32_t)((uint64_t)latest.speedMmS * occludedUs / 1000000ULL);
+  latest.transitUs = transit;
+  latest.occludedUs = occludedUs;
+  latest.beams = __builtin_popcountll(common);
+  seen[from] = false; // 一次断光只配对一次
+  return true;
+}
+
+void MotionEstimator::writeJSON(Print &out) const {
+  out.printf("{\"from\":%u,\"to\":%u,\"direction\":%d,\"speedMmS\":%lu,"
+             "\"lengthMm\":%lu,\"transitUs\":%lu,\"occludedUs\":%lu,"
+             "\"beams\":%u}",
+             latest.fromDevice, latest.toDevice, latest.direction,
+             (unsigned long)latest.speedMmS, (unsigned long)latest.lengthMm,
+             (unsigned long)latest.transitUs, (unsigned long)latest.occludedUs,
+             latest.beams);
+}
@@ -0,0 +1,58 @@
+#ifndef MOTIONESTIMATOR_H
+#define MOTIONESTIMATOR_H
+
+#include <Arduino.h>
+
+#define MOTION_DEVICES 4
+#define MOTION_BEAMS 48
+
+#ifndef MOTION_MAX_TRANSIT_MS
+#define MOTION_MAX_TRANSIT_MS 5000 // 两台接收器断光间隔超过该值不视为同一物体
+#endif
+
+// 一次完整通过的估计结果
+struct MotionEstimate {
+  uint8_t fromDevice;  // 先被遮挡的设备 (1-4)
+  uint8_t toDevice;    // 后被遮挡的设备 (1-4)
+  int8_t direction;    // +1：沿安装位置增大方向，-1：反向
+  uint32_t speedMmS;   // 速度 mm/s
+  uint32_t lengthMm;   // 物体沿运动方向的长度 mm
+  uint32_t transitUs;  // 两台设备之间的通过时间
+  uint32_t occludedUs; // 物体在 toDevice 上的遮挡时长
+  uint8_t beams;       // 参与配对的光束数，0 = 无共同光束，按设备整体边沿估计
+};
+
+// 物体速度/方向/长度估计：跟踪各设备每路光束的断光 (0->缺失) 与复光 (缺失->0) 边沿，
+// 结合设备沿传送方向的安装位置计算。同一设备的 48 路在一次 Modbus 读取中采样，
+// 边沿时间戳取上一次与本次读取的中点。两台设备上同一输入号的光束看到物体的同一截面，
+// 逐光束的通过时间取平均，不受物体轮廓影响；每轮扫描只遍历发生边沿的光束，代价有上界。
+class MotionEstimator {
+private:
+  int32_t positionMm[MOTION_DEVICES]; // 安装位置，相同位置的设备之间不做估计
+  uint64_t prevMissing[MOTION_DEVICES];
+  uint64_t brokenBeams[MOTION_DEVICES]; // 本次遮挡过程中断过光的光束
+  unsigned long beamBreakUs[MOTION_DEVICES][MOTION_BEAMS];   // 本次遮挡中首次断光
+  unsigned long beamRestoreUs[MOTION_DEVICES][MOTION_BEAMS]; // 最近一次复光
+  bool occluded[MOTION_DEVICES];
+  bool seen[MOTION_DEVICES]; // breakUs 有效
+  unsigned long breakUs[MOTION_DEVICES];   // 设备整体：首个光束断光
+  unsigned long restoreUs[MOTION_DEVICES]; // 设备整体：最后一个光束复光
+  MotionEstimate latest;
+
+  bool estimate(int device);
+  uint32_t beamTransit(int from, int to, uint64_t beams, bool trailing) const;
+
+public:
+  MotionEstimator();
+
+  void setPosition(int device, int32_t mm) { positionMm[device] = mm; }
+  void reset();
+  // 写入设备 (0-3) 本轮的缺失掩码；完成一次通过估计时返回 true
+  bool update(int device, uint64_t missing, unsigned long prevReadUs,
+              unsigned long readUs);
+
+  const MotionEstimate &getLatest() const { return latest; }
+  void writeJSON(Print &out) const;
+};
+
+#endif
@@ -0,0 +1,41 @@
+#include "OcclusionAnalyzer.h"
+
+void OcclusionAnalyzer::clear() {
+  runCount = 0;
+  totalRuns = 0;
+  maxWidth = 0;
+}
+
+// 每段两次 CTZ：起点为最低置位，宽度为右移后最低零位；
+// 随后整段清零，代价与段数成正比而非光束数
+uint8_t OcclusionAnalyzer::add(uint8_t device, uint64_t mask) {
+  uint8_t widest = 0;
+  while (mask) {
+    uint8_t start = __builtin_ctzll(mask);
+    uint64_t shifted = mask >> start;
+    uint8_t width = ~shifted ? __builtin_ctzll(~shifted) : 64 - start;
+    mask &= width + start >= 64 ? 0 : ~0ULL << (start + width);
+
+    if (width > widest)
+      widest = width;
+    if (runCount < OCCLUSION_MAX_RUNS) {
+      runs[runCount].device = device;
+      runs[runCount].start = start + 1;
+      runs[runCount].width = width;
+      runCount++;
+    }
+    if (totalRuns < 255)
+      totalRuns++;
+  }
+  if (widest > maxWidth)
+    maxWidth = widest;
+  return widest;
+}
+
+void OcclusionAnalyzer::writeJSON(Print &out) const {
+  out.print('[');
+  for (uint8_t i = 0; i < runCount; i++)
+    out.printf("%s[%u,%u,%u]", i ? "," : "", runs[i].device, runs[i].start,
+               runs[i].width);
+  out.print(']');
+}
@@ -0,0 +1,42 @@
+#ifndef OCCLUSIONANALYZER_H
+#define OCCLUSIONANALYZER_H
+
+#include <Arduino.h>
+
+#ifndef OCCLUSION_MAX_RUNS
+#define OCCLUSION_MAX_RUNS 16 // 每轮保存的连续遮挡段上限 (超出部分仍参与最宽统计)
+#endif
+
+// 一段连续缺失的光束：设备 device (1-4) 上输入 start 起的 width 路
+struct OcclusionRun {
+  uint8_t device;
+  uint8_t start;
+  uint8_t width;
+};
+
+// 逐轮遮挡分析：从位压缩缺失掩码中用 CTZ 提取连续段，
+// 区分成片的物体遮挡与零散的灰尘/噪声缺失
+class OcclusionAnalyzer {
+private:
+  OcclusionRun runs[OCCLUSION_MAX_RUNS];
+  uint8_t runCount;
+  uint8_t totalRuns; // 含未保存的段
+  uint8_t maxWidth;
+
+public:
+  OcclusionAnalyzer() { clear(); }
+
+  void clear();
+  // 分析一台设备的掩码 (bit i = 输入 i+1)，返回该设备最宽连续段的宽度
+  uint8_t add(uint8_t device, uint64_t mask);
+
+  uint8_t getRunCount() const { return runCount; }
+  const OcclusionRun &getRun(uint8_t i) const { return runs[i]; }
+  bool overflowed() const { return totalRuns > runCount; }
+  uint8_t getMaxWidth() const { return maxWidth; }
+
+  // [[device,start,width],...]
+  void writeJSON(Print &out) const;
+};
+
+#endif
@@ -0,0 +1,210 @@
+#include "OtaUpdater.h"
+#include <Update.h>
+#include <mbedtls/sha256.h>
+
+static bool parseHexDigest(const char *hex, uint8_t out[32]) {
+  if (hex == nullptr || strlen(hex) != 64)
+    return false;
+  for (int i = 0; i < 32; i++) {
+    uint8_t value = 0;
+    for (int j = 0; j < 2; j++) {
+      char c = hex[i * 2 + j];
+      value <<= 4;
+      if (c >= '0' && c <= '9')
+        value |= c - '0';
+      else if (c >= 'a' && c <= 'f')
+        value |= c - 'a' + 10;
+      else if (c >= 'A' && c <= 'F')
+        value |= c - 'A' + 10;
+      else
+        return false;
+    }
+    out[i] = value;
+  }
+  return true;
+}
+
+OtaUpdater::OtaUpdater() {
+  taskHandle = nullptr;
+  state = OTA_IDLE;
+  received = 0;
+  total = 0;
+  hasExpectedHash = false;
+  error[0] = '\0';
+}
+
+bool OtaUpdater::start(WiFiClient &source, size_t size, const char *sha256Hex) {
+  if (isBusy()) {
+    strlcpy(error, "OTA already in progress", sizeof(error));
+    return false;
+  }
+  if (size == 0) {
+    strlcpy(error, "No Content", sizeof(error));
+    return false;
+  }
+
+  hasExpectedHash = sha256Hex != nullptr && sha256Hex[0] != '\0';
+  if (hasExpectedHash && !parseHexDigest(sha256Hex, expectedHash)) {
+    strlcpy(error, "Invalid SHA-256", sizeof(error));
+    return false;
+  }
+#if OTA_REQUIRE_SHA256
+  if (!hasExpectedHash) {
+    strlcpy(error, "Missing SHA-256", sizeof(error));
+    return false;
+  }
+#endif
+
+  if (!Update.begin(size)) {
+    strlcpy(error, "Not enough space", sizeof(error));
+    return false;
+  }
+
+  client = source;
+  total = size;
+  received = 0;
+  error[0] = '\0';
+  state = OTA_RECEIVING;
+
+  if (xTaskCreatePinnedToCore(taskEntry, "ota", 4096, this, OTA_TASK_PRIORITY,
+                              &taskHandle, OTA_TASK_CORE) != pdPASS) {
+    Update.abort();
+    client = WiFiClient();
+    taskHandle = nullptr;
+    state = OTA_FAILED;
+    strlcpy(error, "Task create failed", sizeof(error));
+    return false;
+  }
+
+  Serial.printf("OTA started in background: %u bytes, SHA-256 %s\n", size,
+                hasExpectedHash ? "supplied" : "NOT supplied");
+  return true;
+}
+
+void OtaUpdater::taskEntry(void *arg) {
+  static_cast<OtaUpdater *>(arg)->run();
+}
+
+void OtaUpdater::fail(const char *reason) {
+  strlcpy(error, reason, sizeof(error));
+  state = OTA_FAILED;
+  Serial.printf("OTA failed: %s\n", reason);
+}
+
+void OtaUpdater::sendResponse(int code, const char *message) {
+  client.printf("HTTP/1.1 %d %s\r\n", code, code == 200 ? "OK" : "Bad Request");
+  client.print("Content-Type: text/plain\r\n");
+  client.print("Access-Control-Allow-Origin: *\r\n");
+  client.print("Connection: close\r\n");
+  client.printf("Content-Length: %u\r\n\r\n", (unsigned)strlen(message));
+  client.print(message);
+  client.flush();
+}
+
+void OtaUpdater::run() {
+  mbedtls_sha256_context ctx;
+  mbedtls_sha256_init(&ctx);
+  mbedtls_sha256_starts(&ctx, 0);
+
+  unsigned long lastData = millis();
+  while (received < total) {
+    int available = client.available();
+    if (available <= 0) {
+      if (!client.connected()) {
+        fail("Connection lost");
+        break;
+      }
+      if (millis() - lastData > OTA_STALL_TIMEOUT_MS) {
+        fail("Transfer stalled");
+        break;
+      }
+      vTaskDelay(pdMS_TO_TICKS(2));
+      continue;
+    }
+
+    size_t chunk = total - received;
+    if (chunk > sizeof(buffer))
+      chunk = sizeof(buffer);
+    if (chunk > (size_t)available)
+      chunk = available;
+
+    int n = client.read(buffer, chunk);
+    if (n <= 0)
+      continue;
+
+    mbedtls_sha256_update(&ctx, buffer, n);
+    if (Update.write(buffer, n) != (size_t)n) {
+      fail(Update.errorString());
+      break;
+    }
+    received += n;
+    lastData = millis();
+  }
+
+  uint8_t digest[32];
+  mbedtls_sha256_finish(&ctx, digest);
+  mbedtls_sha256_free(&ctx);
+
+  if (state == OTA_RECEIVING) {
+    state = OTA_VERIFYING;
+    if (hasExpectedHash && memcmp(digest, expectedHash, sizeof(digest)) != 0) {
+      fail("SHA-256 mismatch");
+    } else if (!Update.end()) {
+      // Update.end() 内部校验镜像并设置启动分区
+      fail(Update.errorString());
+    } else {
+      state = OTA_SUCCESS;
+    }
+  }
+
+  if (state == OTA_SUCCESS) {
+    Serial.println("OTA verified, boot partition switched. Rebooting...");
+    sendResponse(200, "OK");
+    client.stop();
+    // 留出时间让 SSE 推送完成事件
+    vTaskDelay(pdMS_TO_TICKS(1000));
+    ESP.restart();
+  } else {
+    Update.abort();
+    sendResponse(400, error);
+    client.stop();
+  }
+
+  client = WiFiClient();
+  taskHandle = nullptr;
+  vTaskDelete(nullptr);
+}
+
+bool OtaUpdater::isBusy() { return taskHandle != nullptr; }
+
+OtaState OtaUpdater::getState() { return state; }
+
+const char *OtaUpdater::getStateName() {
+  switch (state) {
+  case OTA_RECEIVING:
+    return "receiving";
+  case OTA_VERIFYING:
+    return "verifying";
+  case OTA_SUCCESS:
+    return "success";
+  case OTA_FAILED:
+    return "failed";
+  default:
+    return "idle";
+  }
+}
+
+size_t OtaUpdater::getReceived() { return received; }
+
+size_t OtaUpdater::getTotal() { return total; }
+
+uint8_t OtaUpdater::getPercent() {
+  return total > 0 ? (uint8_t)((uint64_t)received * 100 / total) : 0;
+}
+
+const char *OtaUpdater::getError() { return error; }
+
+UBaseType_t OtaUpdater::getStackHighWaterMark() {
+  TaskHandle_t handle = taskHandle;
+  return handle != nullptr ? uxTaskGetStackHighWaterMark(handle) : 0;
+}
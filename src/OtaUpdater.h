@@ -0,0 +1,66 @@
+#ifndef OTAUPDATER_H
+#define OTAUPDATER_H
+
+#include <Arduino.h>
+#include <WiFi.h>
+
+// ============== OTA 配置 (可在 platformio.ini build_flags 中覆盖) ==============
+#ifndef OTA_REQUIRE_SHA256
+#define OTA_REQUIRE_SHA256 1        // 1: 必须提供 SHA-256，否则拒绝升级
+#endif
+#ifndef OTA_TASK_PRIORITY
+#define OTA_TASK_PRIORITY 1         // 低优先级，不抢占扫描
+#endif
+#ifndef OTA_TASK_CORE
+#define OTA_TASK_CORE 0             // Arduino loop() 运行在 core 1
+#endif
+#ifndef OTA_CHUNK_SIZE
+#define OTA_CHUNK_SIZE 4096         // 单次读取/写入 Flash 的块大小
+#endif
+#ifndef OTA_STALL_TIMEOUT_MS
+#define OTA_STALL_TIMEOUT_MS 10000  // 数据中断超时
+#endif
+
+enum OtaState : uint8_t {
+  OTA_IDLE,
+  OTA_RECEIVING,
+  OTA_VERIFYING,
+  OTA_SUCCESS,
+  OTA_FAILED
+};
+
+// 后台固件升级：HTTP 处理函数把 socket 交给独立任务，
+// 任务按块读取 (TCP 窗口天然形成流控)、增量计算 SHA-256 并写入 OTA 分区，
+// 校验通过才调用 Update.end() 切换启动分区。
+class OtaUpdater {
+private:
+  WiFiClient client;
+  TaskHandle_t taskHandle;
+  volatile OtaState state;
+  volatile size_t received;
+  size_t total;
+  bool hasExpectedHash;
+  uint8_t expectedHash[32];
+  char error[48];
+  uint8_t buffer[OTA_CHUNK_SIZE];
+
+  static void taskEntry(void *arg);
+  void run();
+  void fail(const char *reason);
+  void sendResponse(int code, const char *message);
+
+public:
+  OtaUpdater();
+  // 成功时接管 client；返回 false 时 getError() 给出原因，client 仍归调用方
+  bool start(WiFiClient &client, size_t size, const char *sha256Hex);
+  bool isBusy();
+  OtaState getState();
+  const char *getStateName();
+  size_t getReceived();
+  size_t getTotal();
+  uint8_t getPercent();
+  const char *getError();
+  UBaseType_t getStackHighWaterMark();
+};
+
+#endif
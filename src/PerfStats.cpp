@@ -0,0 +1,135 @@
+#include "PerfStats.h"
+#include <cstring>
+
+PerfStats perf;
+
+static const char *const PHASE_NAMES[PHASE_COUNT] = {
+    "tx", "wait", "rx", "crc", "decode", "detect", "web", "log"};
+
+PerfStats::PerfStats() : rawCapture(false) { reset(); }
+
+const char *PerfStats::phaseName(uint8_t phase) {
+  return phase < PHASE_COUNT ? PHASE_NAMES[phase] : "?";
+}
+
+// 小于 PERF_SUB_BUCKETS 的值线性分桶；之后每个倍程按最高位后的
+// PERF_SUB_BUCKET_BITS 位细分
+uint16_t PerfStats::bucketIndex(uint32_t cycles) {
+  if (cycles < PERF_SUB_BUCKETS)
+    return cycles;
+  int msb = 31 - __builtin_clz(cycles);
+  if (msb >= PERF_MAX_OCTAVE)
+    return PERF_BUCKET_COUNT - 1;
+  uint32_t sub = (cycles >> (msb - PERF_SUB_BUCKET_BITS)) & (PERF_SUB_BUCKETS - 1);
+  return (msb - PERF_SUB_BUCKET_BITS + 1) * PERF_SUB_BUCKETS + sub;
+}
+
+uint32_t PerfStats::bucketUpperBound(uint16_t index) {
+  if (index < PERF_SUB_BUCKETS)
+    return index;
+  int msb = index / PERF_SUB_BUCKETS + PERF_SUB_BUCKET_BITS - 1;
+  uint32_t sub = index % PERF_SUB_BUCKETS;
+  uint32_t width = 1UL << (msb - PERF_SUB_BUCKET_BITS);
+  return ((PERF_SUB_BUCKETS + sub) << (msb - PERF_SUB_BUCKET_BITS)) + width - 1;
+}
+
+void PerfStats::record(uint8_t device, PerfPhase phase, uint32_t cycles) {
+  if (device >= PERF_SERIES || phase >= PHASE_COUNT)
+    return;
+  PerfHistogram &h = series[device][phase];
+  h.buckets[bucketIndex(cycles)]++;
+  if (h.count == 0 || cycles < h.min)
+    h.min = cycles;
+  if (cycles > h.max)
+    h.max = cycles;
+  h.count++;
+  h.sum += cycles;
+
+#if PERF_RAW_SAMPLES > 0
+  if (rawCapture) {
+    PerfSample &s = raw[rawHead];
+    s.cycles = cycles;
+    s.device = device;
+    s.phase = phase;
+    rawHead = (rawHead + 1) % PERF_RAW_SAMPLES;
+    if (rawCount < PERF_RAW_SAMPLES)
+      rawCount++;
+  }
+#endif
+}
+
+void PerfStats::reset() {
+  memset(series, 0, sizeof(series));
+#if PERF_RAW_SAMPLES > 0
+  rawHead = 0;
+  rawCount = 0;
+#endif
+}
+
+void PerfStats::setRawCapture(bool enable) {
+#if PERF_RAW_SAMPLES > 0
+  rawCapture = enable;
+#else
+  (void)enable;
+#endif
+}
+
+// 返回包含第 pct 百分位样本的桶上界 (不超过实测最大值)
+uint32_t PerfStats::percentile(const PerfHistogram &h, uint8_t pct) {
+  if (h.count == 0)
+    return 0;
+  uint32_t target = (uint32_t)(((uint64_t)h.count * pct + 99) / 100);
+  uint32_t seen = 0;
+  for (uint16_t i = 0; i < PERF_BUCKET_COUNT; i++) {
+    seen += h.buckets[i];
+    if (seen >= target) {
+      uint32_t bound = bucketUpperBound(i);
+      return bound < h.max ? bound : h.max;
+    }
+  }
+  return h.max;
+}
+
+// 耗时统一换算为微秒输出
+void PerfStats::writeJSON(Print &out) const {
+  float mhz = ESP.getCpuFreqMHz();
+#if PERF_RAW_SAMPLES > 0
+  out.printf("{\"cpuMHz\":%u,\"rawCapture\":%s,\"rawSamples\":%u,\"series\":[",
+             (unsigned)mhz, rawCapture ? "true" : "false", rawCount);
+#else
+  out.printf("{\"cpuMHz\":%u,\"rawCapture\":false,\"rawSamples\":0,\"series\":[",
+             (unsigned)mhz);
+#endif
+  bool first = true;
+  for (uint8_t d = 0; d < PERF_SERIES; d++) {
+    for (uint8_t p = 0; p < PHASE_COUNT; p++) {
+      const PerfHistogram &h = series[d][p];
+      if (h.count == 0)
+        continue;
+      if (!first)
+        out.print(',');
+      first = false;
+      out.printf("{\"device\":%u,\"phase\":\"%s\",\"count\":%u,\"minUs\":%.2f,"
+                 "\"meanUs\":%.2f,\"p50Us\":%.2f,\"p90Us\":%.2f,\"p99Us\":%.2f,"
+                 "\"maxUs\":%.2f}",
+                 d, PHASE_NAMES[p], h.count, h.min / mhz,
+                 (float)((double)h.sum / h.count / mhz),
+                 percentile(h, 50) / mhz, percentile(h, 90) / mhz,
+                 percentile(h, 99) / mhz, h.max / mhz);
+    }
+  }
+  out.print("]}");
+}
+
+// 按时间先后输出原始样本 (周期数)，供离线分析
+void PerfStats::writeRawCSV(Print &out) const {
+  out.printf("# cpuMHz=%u\ndevice,phase,cycles\n",
+             (unsigned)ESP.getCpuFreqMHz());
+#if PERF_RAW_SAMPLES > 0
+  uint16_t start = (rawHead + PERF_RAW_SAMPLES - rawCount) % PERF_RAW_SAMPLES;
+  for (uint16_t i = 0; i < rawCount; i++) {
+    const PerfSample &s = raw[(start + i) % PERF_RAW_SAMPLES];
+    out.printf("%u,%s,%u\n", s.device, PHASE_NAMES[s.phase], s.cycles);
+  }
+#endif
+}
@@ -0,0 +1,93 @@
+#ifndef PERFSTATS_H
+#define PERFSTATS_H
+
+#include <Arduino.h>
+
+// 每个 2 的幂区间再细分的子桶位数 (2 位 = 每倍程 4 个桶，相对误差 <25%)
+#ifndef PERF_SUB_BUCKET_BITS
+#define PERF_SUB_BUCKET_BITS 2
+#endif
+// 记录的最大周期数约 2^PERF_MAX_OCTAVE (240MHz 下 2^28 ≈ 1.1s)，超出归入末桶
+#ifndef PERF_MAX_OCTAVE
+#define PERF_MAX_OCTAVE 28
+#endif
+// 原始样本环形缓冲区容量 (0 = 不编译原始样本导出)
+#ifndef PERF_RAW_SAMPLES
+#define PERF_RAW_SAMPLES 512
+#endif
+
+#define PERF_NUM_DEVICES 4
+#define PERF_SCAN_WIDE 0 // 整轮扫描级别的阶段记在 device 0
+#define PERF_SERIES (PERF_NUM_DEVICES + 1)
+
+#define PERF_SUB_BUCKETS (1 << PERF_SUB_BUCKET_BITS)
+#define PERF_BUCKET_COUNT ((PERF_MAX_OCTAVE - PERF_SUB_BUCKET_BITS + 1) * PERF_SUB_BUCKETS)
+
+enum PerfPhase : uint8_t {
+  PHASE_TX,     // 请求写出并发送完毕
+  PHASE_WAIT,   // 等待首字节
+  PHASE_RX,     // 首字节到完整响应
+  PHASE_CRC,    // CRC 校验
+  PHASE_DECODE, // 位解包
+  PHASE_DETECT, // 缺失点比较与去抖
+  PHASE_WEB,    // 网页状态更新 / SSE 广播
+  PHASE_LOG,    // 串口日志
+  PHASE_COUNT
+};
+
+// 对数-线性直方图 (HDR 风格)，按周期计数，仅由 loopTask 写入
+struct PerfHistogram {
+  uint32_t buckets[PERF_BUCKET_COUNT];
+  uint32_t count;
+  uint32_t min;
+  uint32_t max;
+  uint64_t sum;
+};
+
+struct PerfSample {
+  uint32_t cycles;
+  uint8_t device;
+  uint8_t phase;
+};
+
+class PerfStats {
+private:
+  PerfHistogram series[PERF_SERIES][PHASE_COUNT];
+#if PERF_RAW_SAMPLES > 0
+  PerfSample raw[PERF_RAW_SAMPLES];
+  uint16_t rawHead;
+  uint16_t rawCount;
+#endif
+  bool rawCapture;
+
+  static uint16_t bucketIndex(uint32_t cycles);
+  static uint32_t bucketUpperBound(uint16_t index);
+  static uint32_t percentile(const PerfHistogram &h, uint8_t pct);
+
+public:
+  PerfStats();
+
+  // 读取 CPU 周期计数器
+  static uint32_t now() { return ESP.getCycleCount(); }
+
+  void record(uint8_t device, PerfPhase phase, uint32_t cycles);
+  // 记录 stamp 到现在的耗时并把 stamp 推进到现在，便于连续分段计时
+  void lap(uint8_t device, PerfPhase phase, uint32_t &stamp) {
+    uint32_t t = now();
+    record(device, phase, t - stamp);
+    stamp = t;
+  }
+
+  void reset();
+  void setRawCapture(bool enable);
+  bool getRawCapture() const { return rawCapture; }
+
+  void writeJSON(Print &out) const;
+  void writeRawCSV(Print &out) const;
+
+  static const char *phaseName(uint8_t phase);
+};
+
+extern PerfStats perf;
+
+#endif
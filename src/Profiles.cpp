@@ -0,0 +1,111 @@
+#include "Profiles.h"
+#include <cstddef>
+#include <cstring>
+
+ProfileStore profiles;
+
+void sealProfile(Profile &profile) {
+  profile.version = PROFILE_VERSION;
+  profile.size = sizeof(Profile);
+  profile.crc = crc32(&profile, offsetof(Profile, crc));
+}
+
+bool verifyProfile(const Profile &profile) {
+  return profile.version == PROFILE_VERSION &&
+         profile.size == sizeof(Profile) &&
+         profile.crc == crc32(&profile, offsetof(Profile, crc)) &&
+         profile.zoneCount <= MAX_ZONES &&
+         validProfileName(profile.name) &&
+         validateDetectionConfig(profile.detection) == nullptr;
+}
+
+bool validProfileName(const char *name) {
+  size_t len = strnlen(name, PROFILE_NAME_LEN);
+  if (len == 0 || len >= PROFILE_NAME_LEN)
+    return false;
+  for (size_t i = 0; i < len; i++) {
+    if ((unsigned char)name[i] < 0x20 || name[i] == '"' || name[i] == '\\')
+      return false;
+  }
+  return true;
+}
+
+ProfileStore::ProfileStore() : active(-1), dirty(0) {
+  memset(used, 0, sizeof(used));
+}
+
+int ProfileStore::find(const char *name) const {
+  for (int i = 0; i < MAX_PROFILES; i++)
+    if (used[i] && strncmp(slots[i].name, name, PROFILE_NAME_LEN) == 0)
+      return i;
+  return -1;
+}
+
+int ProfileStore::save(const Profile &profile) {
+  int index = find(profile.name);
+  for (int i = 0; index < 0 && i < MAX_PROFILES; i++)
+    if (!used[i])
+      index = i;
+  if (index < 0)
+    return -1;
+  slots[index] = profile;
+  sealProfile(slots[index]);
+  used[index] = true;
+  dirty |= 1 << index;
+  return index;
+}
+
+bool ProfileStore::remove(const char *name) {
+  int index = find(name);
+  if (index < 0)
+    return false;
+  used[index] = false;
+  if (active == index)
+    active = -1;
+  dirty |= 1 << index;
+  return true;
+}
+
+bool ProfileStore::restore(int index, const Profile &profile) {
+  if (index < 0 || index >= MAX_PROFILES || !verifyProfile(profile))
+    return false;
+  slots[index] = profile;
+  used[index] = true;
+  return true;
+}
+
+const Profile *ProfileStore::get(int index) const {
+  if (index < 0 || index >= MAX_PROFILES || !used[index])
+    return nullptr;
+  return &slots[index];
+}
+
+uint8_t ProfileStore::takeDirty() {
+  uint8_t what = dirty;
+  dirty = 0;
+  return what;
+}
+
+// {"active":"A","maxProfiles":4,"profiles":[{"name":"A","shielded":3,"zones":1,"revision":7}]}
+void ProfileStore::writeJSON(Print &out) const {
+  if (active >= 0)
+    out.printf("{\"active\":\"%s\"", slots[active].name);
+  else
+    out.print("{\"active\":null");
+  out.printf(",\"maxProfiles\":%d,\"profiles\":[", MAX_PROFILES);
+  bool first = true;
+  for (int i = 0; i < MAX_PROFILES; i++) {
+    if (!used[i])
+      continue;
+    int shielded = 0;
+    for (int b = 0; b < CONFIG_SHIELD_BYTES; b++)
+      shielded += __builtin_popcount(slots[i].shielding[b]);
+    out.printf("%s{\"name\":\"%s\",\"shielded\":%d,\"zones\":%u,"
+               "\"filter\":%ld,\"revision\":%lu}",
+               first ? "" : ",", slots[i].name, shielded, slots[i].zoneCount,
+               (long)slots[i].triggerFilterThreshold,
+               (unsigned long)slots[i].detection.revision);
+    first = false;
+  }
+  out.print("]}");
+}
@@ -0,0 +1,66 @@
+#ifndef PROFILES_H
+#define PROFILES_H
+
+#include "ConfigRecord.h"
+#include "Zones.h"
+#include <Arduino.h>
+
+#ifndef MAX_PROFILES
+#define MAX_PROFILES 4
+#endif
+
+#define PROFILE_VERSION 1
+#define PROFILE_NAME_LEN 16
+
+// 一个产品的完整检测配置：屏蔽、分区、检测参数和过滤阈值
+struct Profile {
+  uint16_t version; // PROFILE_VERSION
+  uint16_t size;    // sizeof(Profile)
+  char name[PROFILE_NAME_LEN];
+  uint8_t shielding[CONFIG_SHIELD_BYTES];
+  int32_t triggerFilterThreshold;
+  DetectionConfig detection;
+  uint8_t zoneCount;
+  Zone zones[MAX_ZONES];
+  uint32_t crc; // CRC-32，覆盖此前全部字节
+};
+
+enum ProfileAction : uint8_t {
+  PROFILE_SAVE,     // 把当前配置保存为方案
+  PROFILE_ACTIVATE, // 切换到方案
+  PROFILE_DELETE,
+};
+
+void sealProfile(Profile &profile);
+bool verifyProfile(const Profile &profile);
+// 名称原样写入 JSON，只允许可打印且无需转义的字符
+bool validProfileName(const char *name);
+
+// 全部配置方案常驻内存，切换时无需读 Flash
+class ProfileStore {
+private:
+  Profile slots[MAX_PROFILES];
+  bool used[MAX_PROFILES];
+  int8_t active; // 最近一次启用的方案，-1 = 无
+  uint8_t dirty; // 待写入 Flash 的槽位 (按位)
+
+public:
+  ProfileStore();
+
+  int find(const char *name) const;
+  // 同名覆盖，否则占用空槽；已满返回 -1
+  int save(const Profile &profile);
+  bool remove(const char *name);
+  // 从 Flash 加载的槽位，校验失败返回 false
+  bool restore(int index, const Profile &profile);
+  const Profile *get(int index) const;
+  int getActive() const { return active; }
+  void setActive(int index) { active = index; }
+  // 取出待写入的槽位并清除标记
+  uint8_t takeDirty();
+  void writeJSON(Print &out) const;
+};
+
+extern ProfileStore profiles;
+
+#endif
@@ -0,0 +1,144 @@
+#include "ResponseWriter.h"
+#include "WebServer.h"
+
+BufferedPrint::BufferedPrint(Print &out) : out(out), used(0), total(0) {}
+
+BufferedPrint::~BufferedPrint() { flush(); }
+
+size_t BufferedPrint::write(uint8_t c) {
+  if (used == sizeof(buffer))
+    flush();
+  buffer[used++] = c;
+  return 1;
+}
+
+size_t BufferedPrint::write(const uint8_t *data, size_t len) {
+  size_t remaining = len;
+  while (remaining > 0) {
+    if (used == sizeof(buffer))
+      flush();
+    size_t chunk = sizeof(buffer) - used;
+    if (chunk > remaining)
+      chunk = remaining;
+    memcpy(buffer + used, data, chunk);
+    used += chunk;
+    data += chunk;
+    remaining -= chunk;
+  }
+  return len;
+}
+
+void BufferedPrint::flush() {
+  if (used > 0) {
+    out.write(buffer, used);
+    total += used;
+    used = 0;
+  }
+}
+
+size_t FixedBufferPrint::write(uint8_t c) { return write(&c, 1); }
+
+size_t FixedBufferPrint::write(const uint8_t *data, size_t len) {
+  if (used + len > capacity) {
+    overflow = true;
+    len = capacity - used;
+  }
+  memcpy(buffer + used, data, len);
+  used += len;
+  return len;
+}
+
+const char *ResponseWriter::statusText(int code) {
+  switch (code) {
+  case 200:
+    return "OK";
+  case 204:
+    return "No Content";
+  case 304:
+    return "Not Modified";
+  case 400:
+    return "Bad Request";
+  case 404:
+    return "Not Found";
+  case 405:
+    return "Method Not Allowed";
+  case 409:
+    return "Conflict";
+  case 501:
+    return "Not Implemented";
+  case 503:
+    return "Service Unavailable";
+  default:
+    return "Error";
+  }
+}
+
+size_t ResponseWriter::formatHeaders(char *buf, size_t bufLen, int code,
+                                     const char *contentType,
+                                     size_t contentLength, bool keepAlive,
+                                     const char *etag) {
+  int n = snprintf(buf, bufLen,
+                   "HTTP/1.1 %d %s\r\n"
+                   "Content-Type: %s\r\n"
+                   "Access-Control-Allow-Origin: *\r\n"
+                   "Access-Control-Allow-Methods: GET, POST, OPTIONS\r\n"
+                   "Access-Control-Allow-Headers: Content-Type, X-Firmware-SHA256\r\n",
+                   code, statusText(code), contentType);
+  if (etag != nullptr && etag[0] != '\0' && n >= 0 && (size_t)n < bufLen) {
+    n += snprintf(buf + n, bufLen - n,
+                  "Cache-Control: no-cache\r\nETag: %s\r\n", etag);
+  }
+  if (code == 503 && n >= 0 && (size_t)n < bufLen) {
+    n += snprintf(buf + n, bufLen - n, "Retry-After: 1\r\n");
+  }
+  if (n >= 0 && (size_t)n < bufLen) {
+    if (keepAlive) {
+      n += snprintf(buf + n, bufLen - n,
+                    "Connection: keep-alive\r\nKeep-Alive: timeout=%d, "
+                    "max=%d\r\n",
+                    WEB_KEEPALIVE_TIMEOUT_MS / 1000,
+                    WEB_KEEPALIVE_MAX_REQUESTS);
+    } else {
+      n += snprintf(buf + n, bufLen - n, "Connection: close\r\n");
+    }
+  }
+  if (n >= 0 && (size_t)n < bufLen) {
+    n += snprintf(buf + n, bufLen - n, "Content-Length: %u\r\n\r\n",
+                  (unsigned)contentLength);
+  }
+  return (n >= 0 && (size_t)n < bufLen) ? (size_t)n : 0;
+}
+
+size_t ResponseWriter::sendHeaders(int code, const char *contentType,
+                                   size_t contentLength, const char *etag) {
+  char header[WEB_HEADER_BUFFER_SIZE];
+  size_t len = formatHeaders(header, sizeof(header), code, contentType,
+                             contentLength, keepAlive, etag);
+  return client.write((const uint8_t *)header, len);
+}
+
+size_t ResponseWriter::send(int code, const char *contentType,
+                            const char *body) {
+  return sendBytes(code, contentType, (const uint8_t *)body, strlen(body));
+}
+
+size_t ResponseWriter::sendBytes(int code, const char *contentType,
+                                 const uint8_t *body, size_t length) {
+  size_t n = sendHeaders(code, contentType, length);
+  if (length > 0)
+    n += client.write(body, length);
+  return n;
+}
+
+size_t ResponseWriter::sendJson(const JsonDocument &doc, int code) {
+  size_t n = sendHeaders(code, "application/json", measureJson(doc));
+  BufferedPrint out(client);
+  serializeJson(doc, out);
+  out.flush();
+  return n + out.bytesWritten();
+}
+
+size_t ResponseWriter::sendError(int code, const char *reason) {
+  keepAlive = false;
+  return send(code, "text/plain", reason);
+}
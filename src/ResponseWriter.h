@@ -0,0 +1,103 @@
+#ifndef RESPONSEWRITER_H
+#define RESPONSEWRITER_H
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+#ifndef WEB_WRITE_BUFFER_SIZE
+#define WEB_WRITE_BUFFER_SIZE 256      // socket 写缓冲 (栈上)
+#endif
+#ifndef WEB_HEADER_BUFFER_SIZE
+#define WEB_HEADER_BUFFER_SIZE 384     // 响应头格式化缓冲 (栈上)
+#endif
+
+// 带固定缓冲的 Print 适配器：攒满一块再写 socket，避免逐字节 send()
+class BufferedPrint : public Print {
+private:
+  Print &out;
+  uint8_t buffer[WEB_WRITE_BUFFER_SIZE];
+  size_t used;
+  size_t total;
+
+public:
+  explicit BufferedPrint(Print &out);
+  ~BufferedPrint();
+  size_t write(uint8_t c) override;
+  size_t write(const uint8_t *data, size_t len) override;
+  void flush() override;
+  size_t bytesWritten() const { return total + used; }
+};
+
+// 只计数不输出，用于在写正文前得到 Content-Length
+class CountingPrint : public Print {
+private:
+  size_t count;
+
+public:
+  CountingPrint() : count(0) {}
+  size_t write(uint8_t) override {
+    count++;
+    return 1;
+  }
+  size_t write(const uint8_t *, size_t len) override {
+    count += len;
+    return len;
+  }
+  size_t length() const { return count; }
+};
+
+// 写入调用方提供的定长缓冲，溢出时置位 overflowed()
+class FixedBufferPrint : public Print {
+private:
+  char *buffer;
+  size_t capacity;
+  size_t used;
+  bool overflow;
+
+public:
+  FixedBufferPrint(char *buffer, size_t capacity)
+      : buffer(buffer), capacity(capacity), used(0), overflow(false) {}
+  size_t write(uint8_t c) override;
+  size_t write(const uint8_t *data, size_t len) override;
+  size_t length() const { return used; }
+  bool overflowed() const { return overflow; }
+};
+
+// 零堆分配的 HTTP 响应输出：
+// 响应头在栈上格式化，正文经 BufferedPrint 直接流式写入 socket。
+class ResponseWriter {
+private:
+  Print &client;
+  bool keepAlive;
+
+public:
+  ResponseWriter(Print &client, bool keepAlive)
+      : client(client), keepAlive(keepAlive) {}
+
+  static const char *statusText(int code);
+  static size_t formatHeaders(char *buf, size_t bufLen, int code,
+                              const char *contentType, size_t contentLength,
+                              bool keepAlive, const char *etag);
+
+  size_t sendHeaders(int code, const char *contentType, size_t contentLength,
+                     const char *etag = nullptr);
+  size_t send(int code, const char *contentType, const char *body);
+  size_t sendBytes(int code, const char *contentType, const uint8_t *body,
+                   size_t length);
+  size_t sendJson(const JsonDocument &doc, int code = 200);
+  size_t sendError(int code, const char *reason);
+
+  // generator(Print &) 会被调用两次：先计数得到 Content-Length，再真正输出
+  template <typename Generator>
+  size_t sendGenerated(const char *contentType, Generator generator) {
+    CountingPrint counter;
+    generator(counter);
+    size_t n = sendHeaders(200, contentType, counter.length());
+    BufferedPrint out(client);
+    generator(out);
+    out.flush();
+    return n + out.bytesWritten();
+  }
+};
+
+#endif
@@ -0,0 +1,55 @@
+#include "ScanWindow.h"
+
+#define ALL_DEVICES_VALID ((1 << SCAN_WINDOW_DEVICES) - 1)
+
+void ScanWindow::push(const PackedScan &scan) {
+  scans[head] = scan;
+  head = (head + 1) % SCAN_WINDOW_SIZE;
+  if (count < SCAN_WINDOW_SIZE)
+    count++;
+}
+
+const PackedScan &ScanWindow::recent(uint8_t age) const {
+  return scans[(head + SCAN_WINDOW_SIZE - 1 - age) % SCAN_WINDOW_SIZE];
+}
+
+bool ScanWindow::vote(uint8_t n, uint8_t k, unsigned long nowMs,
+                      unsigned long maxAgeMs,
+                      uint64_t out[SCAN_WINDOW_DEVICES]) const {
+  if (n == 0 || k == 0 || k > n || n > 15)
+    return false;
+
+  // 位切片计数：planes[j] 的第 i 位是输入 i 计数值的第 j 位 (最多 15)
+  uint64_t planes[SCAN_WINDOW_DEVICES][4] = {};
+  uint8_t used = 0;
+  for (uint8_t age = 0; age < count && used < n; age++) {
+    const PackedScan &scan = recent(age);
+    if (nowMs - scan.timeMs > maxAgeMs)
+      break; // 更早的扫描只会更旧
+    if (scan.validMask != ALL_DEVICES_VALID)
+      continue;
+    for (int d = 0; d < SCAN_WINDOW_DEVICES; d++) {
+      uint64_t carry = scan.bits[d];
+      for (int j = 0; j < 4 && carry; j++) {
+        uint64_t next = planes[d][j] & carry;
+        planes[d][j] ^= carry;
+        carry = next;
+      }
+    }
+    used++;
+  }
+  if (used < n)
+    return false;
+
+  // 逐位计算 count - k 的借位，借位为 1 即 count < k
+  for (int d = 0; d < SCAN_WINDOW_DEVICES; d++) {
+    uint64_t borrow = 0;
+    for (int j = 0; j < 4; j++) {
+      uint64_t a = planes[d][j];
+      uint64_t b = ((k >> j) & 1) ? ~0ULL : 0;
+      borrow = (~a & (b | borrow)) | (a & b & borrow);
+    }
+    out[d] = ~borrow & 0xFFFFFFFFFFFFULL;
+  }
+  return true;
+}
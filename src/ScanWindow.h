@@ -0,0 +1,43 @@
+#ifndef SCANWINDOW_H
+#define SCANWINDOW_H
+
+#include <Arduino.h>
+
+// 滚动窗口保存的最近完整扫描次数 (K)
+#ifndef SCAN_WINDOW_SIZE
+#define SCAN_WINDOW_SIZE 8
+#endif
+
+#define SCAN_WINDOW_DEVICES 4
+
+// 一次扫描的位压缩结果：每台设备 48 路输入占 uint64_t 低 48 位 (bit i = 输入 i+1)
+struct PackedScan {
+  uint64_t bits[SCAN_WINDOW_DEVICES];
+  uint8_t validMask; // bit d = 设备 d+1 本次读取成功
+  unsigned long timeMs;
+};
+
+// 固定容量环形缓冲区，始终保留最近 SCAN_WINDOW_SIZE 次扫描
+class ScanWindow {
+private:
+  PackedScan scans[SCAN_WINDOW_SIZE];
+  uint8_t head; // 下一个写入位置
+  uint8_t count;
+
+public:
+  ScanWindow() : head(0), count(0) {}
+
+  void push(const PackedScan &scan);
+  void clear() { head = count = 0; }
+  uint8_t size() const { return count; }
+  // age = 0 为最新一次
+  const PackedScan &recent(uint8_t age) const;
+
+  // 取最近 n 次全部设备读取成功、且不早于 maxAgeMs 的扫描，
+  // 每路输入在其中至少 k 次为 1 则输出 1 (k == n 即逐位 AND)。
+  // 可用扫描不足 n 次时返回 false。
+  bool vote(uint8_t n, uint8_t k, unsigned long nowMs, unsigned long maxAgeMs,
+            uint64_t out[SCAN_WINDOW_DEVICES]) const;
+};
+
+#endif
@@ -0,0 +1,32 @@
+#include "Tracer.h"
+
+#if TRACE_ENABLED
+
+Tracer tracer;
+
+// 多任务可并发写入：原子递增取槽位，不加锁
+void Tracer::record(const char *name, uint32_t start, uint32_t end) {
+  uint32_t index = head.fetch_add(1, std::memory_order_relaxed);
+  TraceEvent &e = events[index % TRACE_BUFFER_EVENTS];
+  e.name = name;
+  e.start = start;
+  e.duration = end - start;
+  e.task = (uint32_t)(uintptr_t)xTaskGetCurrentTaskHandle();
+}
+
+void Tracer::writeChromeJSON(Print &out) const {
+  uint32_t total = head.load(std::memory_order_relaxed);
+  uint32_t count = total < TRACE_BUFFER_EVENTS ? total : TRACE_BUFFER_EVENTS;
+  out.print("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+  for (uint32_t i = 0; i < count; i++) {
+    const TraceEvent &e = events[(total - count + i) % TRACE_BUFFER_EVENTS];
+    if (i > 0)
+      out.print(',');
+    out.printf("{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%u,\"dur\":%u,"
+               "\"pid\":1,\"tid\":%u}",
+               e.name, e.start, e.duration, e.task);
+  }
+  out.print("]}");
+}
+
+#endif
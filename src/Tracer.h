@@ -0,0 +1,62 @@
+#ifndef TRACER_H
+#define TRACER_H
+
+#include <Arduino.h>
+
+// 编译期开关：0 时 TRACE_SCOPE 展开为空，不占用任何 RAM 与 CPU
+#ifndef TRACE_ENABLED
+#define TRACE_ENABLED 0
+#endif
+// 环形缓冲区事件数 (每个事件 16 字节)
+#ifndef TRACE_BUFFER_EVENTS
+#define TRACE_BUFFER_EVENTS 1024
+#endif
+
+#if TRACE_ENABLED
+
+#include <atomic>
+
+// 一个完整区间 (开始时间 + 持续时间)，导出为 Chrome trace_event "X" 事件
+struct TraceEvent {
+  const char *name; // 必须是字符串字面量
+  uint32_t start;   // micros()
+  uint32_t duration;
+  uint32_t task; // 任务句柄，导出为 tid
+};
+
+class Tracer {
+private:
+  TraceEvent events[TRACE_BUFFER_EVENTS];
+  std::atomic<uint32_t> head; // 累计写入数，取模得到槽位
+
+public:
+  Tracer() : head(0) {}
+  void record(const char *name, uint32_t start, uint32_t end);
+  void clear() { head.store(0, std::memory_order_relaxed); }
+  // 输出 Chrome trace_event JSON (可直接在 chrome://tracing / Perfetto 中打开)
+  void writeChromeJSON(Print &out) const;
+};
+
+extern Tracer tracer;
+
+class TraceScope {
+private:
+  const char *name;
+  uint32_t start;
+
+public:
+  explicit TraceScope(const char *name) : name(name), start(micros()) {}
+  ~TraceScope() { tracer.record(name, start, micros()); }
+};
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_SCOPE(name) TraceScope TRACE_CONCAT(_traceScope, __LINE__)(name)
+
+#else
+
+#define TRACE_SCOPE(name) ((void)0)
+
+#endif
+
+#endif
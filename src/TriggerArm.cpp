@@ -0,0 +1,45 @@
+#include "TriggerArm.h"
+
+void TriggerArm::reset() {
+  state = ARM_ARMED;
+  triggerMs = 0;
+  clearSinceMs = 0;
+  rateWindowMs = 0;
+  rateCount = 0;
+}
+
+bool TriggerArm::fire(const ReArmPolicy &policy, unsigned long nowMs) {
+  if (state != ARM_ARMED)
+    return false;
+  state = ARM_LATCHED;
+  triggerMs = nowMs;
+
+  if (policy.maxPerMinute > 0) {
+    if (rateCount == 0 || nowMs - rateWindowMs >= 60000) {
+      rateWindowMs = nowMs;
+      rateCount = 0;
+    }
+    if (rateCount >= policy.maxPerMinute)
+      return false;
+    rateCount++;
+  }
+  sequence++;
+  return true;
+}
+
+void TriggerArm::update(const ReArmPolicy &policy, bool allClear,
+                        unsigned long nowMs) {
+  if (state == ARM_ARMED || !policy.rearm)
+    return;
+  if (!allClear) {
+    state = ARM_LATCHED;
+    return;
+  }
+  if (state == ARM_LATCHED) {
+    state = ARM_CLEARING;
+    clearSinceMs = nowMs;
+  }
+  if (nowMs - clearSinceMs >= policy.clearMs &&
+      nowMs - triggerMs >= policy.refractoryMs)
+    state = ARM_ARMED;
+}
@@ -0,0 +1,47 @@
+#ifndef TRIGGERARM_H
+#define TRIGGERARM_H
+
+#include <Arduino.h>
+
+// 触发后的重新布防策略
+struct ReArmPolicy {
+  bool rearm;            // false：触发后保持锁定直到重新建立基线 (旧行为)
+  uint16_t clearMs;      // 所有相关光束恢复并持续该时长才算清除
+  uint16_t refractoryMs; // 两次触发之间的最短间隔
+  uint8_t maxPerMinute;  // 每分钟最多触发次数，0 = 不限
+};
+
+enum ArmState : uint8_t {
+  ARM_ARMED,    // 等待触发
+  ARM_LATCHED,  // 已触发，相关光束仍有缺失
+  ARM_CLEARING  // 光束已全部恢复，等待 clearMs 与不应期结束
+};
+
+// 单个触发源 (设备级或某个分区) 的重新布防状态机：
+// ARMED --fire--> LATCHED --全部恢复--> CLEARING --持续 clearMs 且过了不应期--> ARMED
+// CLEARING 期间再次出现缺失则回到 LATCHED
+class TriggerArm {
+private:
+  ArmState state;
+  unsigned long triggerMs;
+  unsigned long clearSinceMs;
+  unsigned long rateWindowMs;
+  uint8_t rateCount;
+  uint32_t sequence; // 启动以来已发出的触发数，重新建立基线不清零
+
+public:
+  TriggerArm() : sequence(0) { reset(); }
+
+  // 重新建立基线时回到 ARMED
+  void reset();
+  bool isArmed() const { return state == ARM_ARMED; }
+  // 规则确认时调用 (须处于 ARMED)；超过速率上限时不发出但同样进入 LATCHED，返回 false
+  bool fire(const ReArmPolicy &policy, unsigned long nowMs);
+  // 每轮扫描调用，allClear 表示相关光束当前全部在线
+  void update(const ReArmPolicy &policy, bool allClear, unsigned long nowMs);
+
+  ArmState getState() const { return state; }
+  uint32_t getSequence() const { return sequence; }
+};
+
+#endif
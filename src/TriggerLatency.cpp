@@ -0,0 +1,67 @@
+#include "TriggerLatency.h"
+#include "Metrics.h"
+#include <cstring>
+
+void TriggerLatency::reset() {
+  memset(lastReadUs, 0, sizeof(lastReadUs));
+  memset(prevReadUs, 0, sizeof(prevReadUs));
+  memset(onsetUs, 0, sizeof(onsetUs));
+  memset(onsetPrevUs, 0, sizeof(onsetPrevUs));
+  resetEpisodes();
+}
+
+void TriggerLatency::resetEpisodes() {
+  memset(episode, 0, sizeof(episode));
+  scanConfirmed = false;
+  scanOnsetUs = 0;
+  scanPrevUs = 0;
+}
+
+void TriggerLatency::recordRead(int device, unsigned long nowUs) {
+  if (device < 0 || device >= TRIGGER_LATENCY_DEVICES)
+    return;
+  prevReadUs[device] = lastReadUs[device];
+  lastReadUs[device] = nowUs;
+}
+
+EpisodeEvent TriggerLatency::update(int device, int missingBits,
+                                    int confirmedBits, int tolerance,
+                                    bool windowPending, bool qualified) {
+  if (device < 0 || device >= TRIGGER_LATENCY_DEVICES)
+    return EPISODE_NONE;
+  EpisodeEvent event = EPISODE_NONE;
+  if (missingBits > 0 && !episode[device]) {
+    episode[device] = true;
+    onsetUs[device] = lastReadUs[device];
+    onsetPrevUs[device] = prevReadUs[device];
+    event = EPISODE_START;
+  } else if (missingBits < tolerance && !windowPending && episode[device]) {
+    episode[device] = false;
+    event = EPISODE_END;
+  }
+
+  if (episode[device] && confirmedBits >= tolerance && qualified) {
+    if (!scanConfirmed || (long)(onsetUs[device] - scanOnsetUs) < 0) {
+      scanOnsetUs = onsetUs[device];
+      scanPrevUs = onsetPrevUs[device];
+    }
+    scanConfirmed = true;
+  }
+  return event;
+}
+
+LatencyStamp TriggerLatency::stamp(unsigned long nowUs) const {
+  LatencyStamp stamp;
+  stamp.prevScanUs = scanConfirmed ? scanPrevUs : 0;
+  stamp.onsetUs = scanConfirmed ? scanOnsetUs : 0;
+  stamp.confirmUs = nowUs;
+  return stamp;
+}
+
+uint32_t TriggerLatency::observe(const LatencyStamp &stamp,
+                                 unsigned long sentUs) {
+  metrics.triggerDetectLatency.observe(stamp.confirmUs - stamp.onsetUs);
+  metrics.triggerPublishLatency.observe(sentUs - stamp.confirmUs);
+  metrics.triggerLatency.observe(sentUs - stamp.onsetUs);
+  return sentUs - stamp.onsetUs;
+}
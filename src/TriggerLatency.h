@@ -0,0 +1,73 @@
+#ifndef TRIGGERLATENCY_H
+#define TRIGGERLATENCY_H
+
+#include <Arduino.h>
+
+#define TRIGGER_LATENCY_DEVICES 4
+
+// 端到端延迟预算 (微秒)：首次缺失扫描 -> MQTT 发布完成。
+// 默认去抖 (90ms 窗口内缺失 60ms) 在约 20-30ms 的扫描周期下需 2-3 轮确认，
+// 超出预算的触发在串口告警
+#ifndef TRIGGER_LATENCY_BUDGET_US
+#define TRIGGER_LATENCY_BUDGET_US 100000
+#endif
+
+// 一次触发的时间戳 (micros())，随触发事件排队直到发布
+struct LatencyStamp {
+  unsigned long prevScanUs; // 首次缺失前的最后一次扫描，断光发生在它与 onsetUs 之间
+  unsigned long onsetUs;    // 触发设备中最早出现缺失的扫描
+  unsigned long confirmUs;  // 去抖确认
+};
+
+// 单台设备本轮的缺失过程变化
+enum EpisodeEvent : uint8_t {
+  EPISODE_NONE,
+  EPISODE_START, // 出现缺失，本轮读取记为 onset
+  EPISODE_END    // 缺失低于容差且去抖窗口内已无缺失记录
+};
+
+// 端到端触发延迟的时间戳簿记：成功读取 -> 缺失过程起点 (onset) -> 去抖确认 -> 发布完成。
+// 一次缺失过程从设备出现任一缺失开始，到去抖窗口内不再有缺失记录为止；
+// 每轮扫描中确认触发的设备取最早的 onset 生成 LatencyStamp
+class TriggerLatency {
+private:
+  unsigned long lastReadUs[TRIGGER_LATENCY_DEVICES];  // 最近一次成功读取时刻
+  unsigned long prevReadUs[TRIGGER_LATENCY_DEVICES];  // 上一次成功读取时刻
+  unsigned long onsetUs[TRIGGER_LATENCY_DEVICES];     // 本次缺失过程的首次扫描时刻
+  unsigned long onsetPrevUs[TRIGGER_LATENCY_DEVICES]; // 首次缺失前的最后一次扫描
+  bool episode[TRIGGER_LATENCY_DEVICES];              // 设备处于一次缺失过程中
+
+  bool scanConfirmed; // 本轮已有设备确认触发
+  unsigned long scanOnsetUs;
+  unsigned long scanPrevUs;
+
+public:
+  TriggerLatency() { reset(); }
+
+  void reset();
+  // 结束所有缺失过程 (重新建立基线、清空去抖历史时)
+  void resetEpisodes();
+
+  // 设备读取成功后调用
+  void recordRead(int device, unsigned long nowUs);
+  // 每轮判断开始时调用，清除上一轮的确认
+  void beginScan() { scanConfirmed = false; }
+  // 每轮对每台读取成功的设备在去抖更新后调用一次：维护缺失过程；
+  // 处于缺失过程中、确认数达到容差且 qualified (如遮挡段宽度满足) 时确认触发，
+  // 其 onset 并入本轮最早的 onset
+  EpisodeEvent update(int device, int missingBits, int confirmedBits,
+                      int tolerance, bool windowPending, bool qualified);
+  bool inEpisode(int device) const { return episode[device]; }
+  // 本轮是否有设备确认触发
+  bool confirmed() const { return scanConfirmed; }
+  // 本轮触发的时间戳，nowUs 为确认时刻
+  LatencyStamp stamp(unsigned long nowUs) const;
+
+  unsigned long getLastRead(int device) const { return lastReadUs[device]; }
+  unsigned long getPrevRead(int device) const { return prevReadUs[device]; }
+
+  // 发布完成：检测/发布/端到端三段延迟计入 metrics 直方图，返回端到端延迟
+  static uint32_t observe(const LatencyStamp &stamp, unsigned long sentUs);
+};
+
+#endif
@@ -1,88 +1,695 @@
 #include "WebServer.h"
+#include "BeamAvailability.h"
+#include "BeamStats.h"
+#include "Calibrator.h"
+#include "ConfigRecord.h"
+#include "DebounceEngine.h"
+#include "DetectionConfig.h"
+#include "Metrics.h"
+#include "PerfStats.h"
+#include "ResponseWriter.h"
+#include "Tracer.h"
 #include <Arduino.h>
-#include <Update.h>
 
-LaserWebServer::LaserWebServer() : server(80) {
+// 页面常驻 Flash，直接从 rodata 写入 socket，不再在堆上拼接
+static const char INDEX_HTML[] PROGMEM = R"rawliteral(<!DOCTYPE html>
+<html lang="en">
+<head>
+    <meta charset="UTF-8">
+    <meta name="viewport" content="width=device-width, initial-scale=1.0">
+    <title>Laser Sensor Monitoring</title>
+    <style>
+        body { font-family: sans-serif; margin: 0; padding: 20px; background: #f0f2f5; }
+        .container { max-width: 1200px; margin: 0 auto; background: white; padding: 20px; border-radius: 12px; box-shadow: 0 4px 6px rgba(0,0,0,0.1); }
+        .header { display: flex; justify-content: space-between; align-items: center; margin-bottom: 20px; }
+        .status-bar { background: #e3f2fd; padding: 10px 20px; border-radius: 8px; margin-bottom: 20px; display: flex; gap: 20px; }
+        .control-panel { background: #f8f9fa; padding: 15px; border-radius: 8px; margin-bottom: 20px; display: flex; flex-wrap: wrap; gap: 15px; align-items: center; }
+        .device-grid { display: grid; grid-template-columns: repeat(auto-fit, minmax(500px, 1fr)); gap: 20px; }
+        .device-card { border: 1px solid #dee2e6; border-radius: 10px; padding: 15px; background: #fff; }
+        .device-title { font-size: 1.25rem; font-weight: bold; margin-bottom: 15px; color: #1a73e8; border-bottom: 2px solid #e8f0fe; padding-bottom: 5px; }
+        .input-grid { display: grid; grid-template-columns: repeat(12, 1fr); gap: 5px; }
+        .input-node { display: flex; flex-direction: column; align-items: center; gap: 2px; }
+        .id-label { font-size: 10px; color: #666; }
+        .led { width: 18px; height: 18px; border-radius: 4px; background: #e0e0e0; border: 1px solid #bdbdbd; cursor: pointer; transition: all 0.2s; }
+        .led:hover { transform: scale(1.2); }
+        .led.active { background: #ff5252; border-color: #d32f2f; box-shadow: 0 0 8px rgba(255,82,82,0.5); }
+        .led.shielded { background: #fb8c00; border-color: #ef6c00; position: relative; }
+        .led.shielded::after { content: '×'; position: absolute; color: white; font-size: 14px; top: 50%; left: 50%; transform: translate(-50%, -50%); }
+        .led.shielded.active { background: #ffa726; opacity: 0.7; }
+        .led.selecting { outline: 2px solid #1a73e8; outline-offset: 1px; }
+        .input-grid.config { user-select: none; touch-action: none; }
+        button { padding: 8px 16px; border: none; border-radius: 4px; background: #1a73e8; color: white; cursor: pointer; transition: background 0.2s; }
+        button:hover { background: #1557b0; }
+        button.secondary { background: #6c757d; }
+        button.danger { background: #dc3545; }
+        input[type='number'] { padding: 6px; border: 1px solid #ced4da; border-radius: 4px; width: 80px; }
+        .zones-panel { background: white; border-radius: 8px; padding: 15px; margin-top: 20px; box-shadow: 0 2px 4px rgba(0,0,0,0.1); }
+        .zones-panel table { width: 100%; border-collapse: collapse; margin-bottom: 10px; font-size: 13px; }
+        .zones-panel th, .zones-panel td { padding: 4px; text-align: left; }
+        .zones-panel input[type='text'] { padding: 6px; border: 1px solid #ced4da; border-radius: 4px; width: 100%; box-sizing: border-box; }
+        #config-banner { display: none; background: #fff3e0; color: #e65100; padding: 10px; border-radius: 4px; text-align: center; margin-bottom: 15px; font-weight: bold; }
+    </style>
+</head>
+<body>
+    <div class="container">
+        <div class="header">
+            <h1>Laser Sensor System</h1>
+            <div id="conn-status" style="color: red; font-weight: bold;">Disconnected</div>
+        </div>
+
+        <div id="config-banner">SHIELD CONFIGURATION MODE ACTIVE - Click or drag a rectangle to toggle mask</div>
+
+        <div class="status-bar">
+            <div>Last Update: <span id="last-time">--:--:--</span></div>
+            <div>Active Clients: <span id="client-count">0</span></div>
+        </div>
+
+        <div class="control-panel">
+            <label>Baseline Delay:</label>
+            <input type="number" id="delay-input" value="200">
+            <button onclick="updateDelay()">Set Delay</button>
+            <label style="margin-left: 15px;">Trigger Filter:</label>
+            <input type="number" id="filter-input" value="20" style="width: 60px;">
+            <button onclick="updateFilter()">Set Filter</button>
+            <button class="secondary" onclick="toggleConfig()" id="config-btn">Enter Shield Config</button>
+            <button class="danger" onclick="clearAllShielding()">Clear All Shields</button>
+            <button class="secondary" onclick="toggleHeatmap()" id="heat-btn">Flicker Heatmap</button>
+            <input type="number" id="flicker-input" value="30" style="width: 60px;">
+            <button class="danger" onclick="shieldNoisy()">Shield &gt; X/min</button>
+            <div style="margin-left: auto;">
+                <input type="file" id="ota-file" style="display:none">
+                <button class="danger" onclick="document.getElementById('ota-file').click()">Select Update</button>
+                <button onclick="doOTA()">Flash</button>
+                <span id="ota-status"></span>
+            </div>
+        </div>
+
+        <div class="device-grid" id="grid"></div>
+
+        <div class="zones-panel">
+            <div class="device-title">Zones (beams 1-192: device 1 = 1-48, device 2 = 49-96 ...)</div>
+            <table>
+                <thead><tr><th>On</th><th>Name</th><th>Beams</th><th>Tolerance</th><th>Window ms</th><th>Debounce ms</th><th>Filter</th><th>MQTT Topic</th><th></th></tr></thead>
+                <tbody id="zones-body"></tbody>
+            </table>
+            <button class="secondary" onclick="addZone()">Add Zone</button>
+            <button onclick="saveZones()">Save Zones</button>
+        </div>
+
+        <div class="zones-panel">
+            <div class="device-title">Profiles (shielding, zones, detection parameters, filter)</div>
+            <select id="profile-select"></select>
+            <button onclick="profileAction('activate')">Activate</button>
+            <button class="secondary" onclick="profileAction('delete')">Delete</button>
+            <input type="text" id="profile-name" placeholder="name" maxlength="15" style="width: 140px;">
+            <button onclick="saveProfile()">Save Current As</button>
+            <span id="profile-active"></span>
+        </div>
+    </div>
+
+    <script>
+        let configMode = false;
+        let shieldMask = {};
+        let eventSource = null;
+
+        function init() {
+            fetch('/api/shield').then(r => r.json()).then(d => {
+                shieldMask = d;
+                applyShieldMask();
+            });
+            fetch('/api/baselineDelay').then(r => r.json()).then(d => document.getElementById('delay-input').value = d.delay);
+            fetch('/api/triggerFilter').then(r => r.json()).then(d => document.getElementById('filter-input').value = d.threshold);
+            loadZones();
+            loadProfiles();
+            setupSSE();
+            renderEmpty();
+        }
+
+        function applyShieldMask() {
+            for(let d=1; d<=4; d++) {
+                const key = 'device' + d;
+                if(shieldMask[key]) {
+                    shieldMask[key].forEach(inputId => {
+                        const led = document.getElementById('l-' + d + '-' + inputId);
+                        if(led) led.classList.add('shielded');
+                    });
+                }
+            }
+        }
+
+        function setupSSE() {
+            if(eventSource) eventSource.close();
+            eventSource = new EventSource('/events');
+            eventSource.onopen = () => {
+                document.getElementById('conn-status').textContent = 'Connected';
+                document.getElementById('conn-status').style.color = 'green';
+            };
+            eventSource.onmessage = e => updateDisplay(JSON.parse(e.data));
+            eventSource.addEventListener('ota', e => {
+                const o = JSON.parse(e.data);
+                document.getElementById('ota-status').textContent = 'OTA ' + o.state + ' ' + o.percent + '%' + (o.error ? ' (' + o.error + ')' : '');
+            });
+            eventSource.onerror = () => {
+                document.getElementById('conn-status').textContent = 'Disconnected';
+                document.getElementById('conn-status').style.color = 'red';
+            };
+        }
+
+        function renderEmpty() {
+            const grid = document.getElementById('grid');
+            grid.innerHTML = '';
+            for(let d=1; d<=4; d++) {
+                const card = document.createElement('div');
+                card.className = 'device-card';
+                card.innerHTML = `<div class='device-title'>Device ${d}</div><div class='input-grid' id='d-${d}'></div>`;
+                grid.appendChild(card);
+                const devGrid = card.querySelector('.input-grid');
+                for(let i=1; i<=48; i++) {
+                    devGrid.innerHTML += `<div class='input-node'><div class='led' id='l-${d}-${i}' onmousedown='selStart(${d},${i})' onmouseenter='selMove(${d},${i})'></div><div class='id-label'>${i}</div></div>`;
+                }
+            }
+        }
+
+        function updateDisplay(data) {
+            document.getElementById('last-time').textContent = new Date().toLocaleTimeString();
+            for(let d=1; d<=4; d++) {
+                const inputs = data['device' + d];
+                if(!inputs) continue;
+                inputs.forEach(input => {
+                    const led = document.getElementById(`l-${d}-${input.id}`);
+                    if(!led) return;
+                    const isShielded = shieldMask['device'+d] && shieldMask['device'+d].includes(input.id);
+                    led.className = 'led' + (input.state ? ' active' : '') + (isShielded ? ' shielded' : '');
+                });
+            }
+        }
+
+        // 拖拽矩形框选：起点与当前光束在屏幕上围成的矩形，可跨设备；鼠标和触摸均可，松开后一次批量提交
+        let sel = null;
+        function isShielded(d, i) {
+            return !!shieldMask['device'+d] && shieldMask['device'+d].includes(i);
+        }
+        function ledRect(d, i) {
+            return document.getElementById(`l-${d}-${i}`).getBoundingClientRect();
+        }
+        function selCells(s) {
+            const a = ledRect(s.d, s.start), b = ledRect(s.endD, s.end);
+            const left = Math.min(a.left, b.left), right = Math.max(a.right, b.right);
+            const top = Math.min(a.top, b.top), bottom = Math.max(a.bottom, b.bottom);
+            const cells = [];
+            for(let d=1; d<=4; d++)
+                for(let i=1; i<=48; i++) {
+                    const r = ledRect(d, i), x = (r.left + r.right) / 2, y = (r.top + r.bottom) / 2;
+                    if(x >= left && x <= right && y >= top && y <= bottom) cells.push({ d: d, i: i });
+                }
+            return cells;
+        }
+        function selPaint(on) {
+            if(!on) {
+                sel.cells.forEach(c => document.getElementById(`l-${c.d}-${c.i}`).classList.remove('selecting'));
+                return;
+            }
+            sel.cells = selCells(sel);
+            sel.cells.forEach(c => document.getElementById(`l-${c.d}-${c.i}`).classList.add('selecting'));
+        }
+        function selStart(d, i) {
+            if(!configMode) return;
+            sel = { d: d, start: i, endD: d, end: i, state: !isShielded(d, i), cells: [] };
+            selPaint(true);
+        }
+        function selMove(d, i) {
+            if(!sel || (d === sel.endD && i === sel.end)) return;
+            selPaint(false);
+            sel.endD = d;
+            sel.end = i;
+            selPaint(true);
+        }
+        function selEnd() {
+            if(!sel) return;
+            selPaint(false);
+            const s = sel; sel = null;
+            const changes = s.cells.filter(c => isShielded(c.d, c.i) !== s.state);
+            if(!changes.length) return;
+            // 按设备提交完整屏蔽列表 (masks)，整框跨设备选中也远小于请求体上限
+            const masks = {};
+            changes.forEach(c => {
+                const key = 'device' + c.d;
+                if(!masks[key]) masks[key] = (shieldMask[key] || []).slice();
+                const idx = masks[key].indexOf(c.i);
+                if(s.state && idx === -1) masks[key].push(c.i);
+                if(!s.state && idx !== -1) masks[key].splice(idx, 1);
+            });
+            fetch('/api/shield/batch', { method: 'POST', body: JSON.stringify({ masks: masks }) })
+            .then(r => {
+                if(!r.ok) return r.text().then(t => alert('Shield update failed: ' + t));
+                Object.assign(shieldMask, masks);
+                changes.forEach(c => document.getElementById(`l-${c.d}-${c.i}`).classList.toggle('shielded', s.state));
+            });
+        }
+        document.addEventListener('mouseup', selEnd);
+
+        // 触摸：按触点位置找到光束，配置模式下拖动时不滚动页面
+        function ledAt(touch) {
+            const el = document.elementFromPoint(touch.clientX, touch.clientY);
+            const m = el && el.id ? el.id.match(/^l-(\d)-(\d+)$/) : null;
+            return m ? { d: parseInt(m[1]), i: parseInt(m[2]) } : null;
+        }
+        document.addEventListener('touchstart', e => {
+            const hit = configMode ? ledAt(e.touches[0]) : null;
+            if(!hit) return;
+            e.preventDefault();
+            selStart(hit.d, hit.i);
+        }, { passive: false });
+        document.addEventListener('touchmove', e => {
+            if(!sel) return;
+            e.preventDefault();
+            const hit = ledAt(e.touches[0]);
+            if(hit) selMove(hit.d, hit.i);
+        }, { passive: false });
+        document.addEventListener('touchend', selEnd);
+        document.addEventListener('touchcancel', selEnd);
+
+        function toggleConfig() {
+            configMode = !configMode;
+            document.getElementById('config-btn').textContent = configMode ? 'Exit Shield Config' : 'Enter Shield Config';
+            document.getElementById('config-btn').classList.toggle('secondary', !configMode);
+            document.getElementById('config-btn').classList.toggle('danger', configMode);
+            document.getElementById('config-banner').style.display = configMode ? 'block' : 'none';
+            document.querySelectorAll('.input-grid').forEach(g => g.classList.toggle('config', configMode));
+        }
+
+        function updateDelay() {
+            const val = document.getElementById('delay-input').value;
+            fetch('/api/baselineDelay', { method: 'POST', body: JSON.stringify({ delay: parseInt(val) }) });
+        }
+
+        function updateFilter() {
+            const val = document.getElementById('filter-input').value;
+            fetch('/api/triggerFilter', { method: 'POST', body: JSON.stringify({ threshold: parseInt(val) }) })
+            .then(r => r.json()).then(d => {
+                alert('Trigger filter set to ' + d.threshold + ' points');
+            });
+        }
+
+        let maxZones = 8;
+        function loadZones() {
+            fetch('/api/zones').then(r => r.json()).then(d => {
+                maxZones = d.maxZones;
+                document.getElementById('zones-body').innerHTML = '';
+                d.zones.forEach(addZone);
+            });
+        }
+
+        function addZone(z) {
+            const body = document.getElementById('zones-body');
+            if(body.rows.length >= maxZones) return alert('At most ' + maxZones + ' zones');
+            z = z || { name: 'zone' + (body.rows.length + 1), enabled: true, beams: '', tolerance: 1, windowMs: 90, debounceMs: 60, filter: 0, topic: '' };
+            const row = body.insertRow();
+            row.innerHTML = `<td><input type='checkbox' class='z-enabled'></td>
+                <td><input type='text' class='z-name'></td>
+                <td><input type='text' class='z-beams' placeholder='1-20,49'></td>
+                <td><input type='number' class='z-tolerance' style='width: 60px;'></td>
+                <td><input type='number' class='z-window' style='width: 70px;'></td>
+                <td><input type='number' class='z-debounce' style='width: 70px;'></td>
+                <td><input type='number' class='z-filter' style='width: 60px;'></td>
+                <td><input type='text' class='z-topic' placeholder='receiver/zone/<name>'></td>
+                <td><button class='danger' onclick='this.closest("tr").remove()'>Remove</button></td>`;
+            row.querySelector('.z-enabled').checked = z.enabled;
+            row.querySelector('.z-name').value = z.name;
+            row.querySelector('.z-beams').value = z.beams;
+            row.querySelector('.z-tolerance').value = z.tolerance;
+            row.querySelector('.z-window').value = z.windowMs;
+            row.querySelector('.z-debounce').value = z.debounceMs;
+            row.querySelector('.z-filter').value = z.filter;
+            row.querySelector('.z-topic').value = z.topic;
+        }
+
+        function saveZones() {
+            const zones = Array.from(document.getElementById('zones-body').rows).map(row => {
+                const z = {
+                    name: row.querySelector('.z-name').value,
+                    enabled: row.querySelector('.z-enabled').checked,
+                    beams: row.querySelector('.z-beams').value,
+                    tolerance: parseInt(row.querySelector('.z-tolerance').value),
+                    windowMs: parseInt(row.querySelector('.z-window').value),
+                    debounceMs: parseInt(row.querySelector('.z-debounce').value),
+                    filter: parseInt(row.querySelector('.z-filter').value)
+                };
+                const topic = row.querySelector('.z-topic').value;
+                if(topic) z.topic = topic;
+                return z;
+            });
+            fetch('/api/zones', { method: 'POST', body: JSON.stringify({ zones: zones }) }).then(r => {
+                if(r.ok) { loadZones(); alert('Zones saved'); }
+                else alert('Invalid zone configuration');
+            });
+        }
+
+        function renderProfiles(d) {
+            const sel = document.getElementById('profile-select');
+            sel.innerHTML = '';
+            d.profiles.forEach(p => {
+                const o = document.createElement('option');
+                o.value = p.name;
+                o.textContent = p.name + ' (' + p.shielded + ' shielded, ' + p.zones + ' zones)';
+                o.selected = p.name === d.active;
+                sel.appendChild(o);
+            });
+            document.getElementById('profile-active').textContent = 'Active: ' + (d.active || '-');
+        }
+        function loadProfiles() {
+            fetch('/api/profiles').then(r => r.json()).then(renderProfiles);
+        }
+        function postProfile(path, name) {
+            return fetch(path, { method: 'POST', body: JSON.stringify({ name: name }) }).then(r => {
+                if(!r.ok) return r.text().then(t => { alert(t); return null; });
+                return r.json();
+            });
+        }
+        function saveProfile() {
+            const name = document.getElementById('profile-name').value.trim();
+            if(!name) return;
+            postProfile('/api/profiles', name).then(d => { if(d) renderProfiles(d); });
+        }
+        // 切换后屏蔽、分区和过滤阈值都已改变，重新加载
+        function profileAction(action) {
+            const name = document.getElementById('profile-select').value;
+            if(!name) return;
+            if(action === 'delete' && !confirm('Delete profile ' + name + '?')) return;
+            postProfile('/api/profiles/' + action, name).then(d => {
+                if(!d) return;
+                renderProfiles(d);
+                if(action !== 'activate') return;
+                fetch('/api/shield').then(r => r.json()).then(m => { shieldMask = m; applyShieldMask(); });
+                fetch('/api/triggerFilter').then(r => r.json()).then(f => document.getElementById('filter-input').value = f.threshold);
+                loadZones();
+            });
+        }
+
+        // 闪烁热力图：紫色外圈越深表示每分钟状态翻转越多，悬停显示具体数值
+        let heatTimer = null;
+        function toggleHeatmap() {
+            const btn = document.getElementById('heat-btn');
+            if(heatTimer) {
+                clearInterval(heatTimer);
+                heatTimer = null;
+                btn.classList.add('secondary');
+                document.querySelectorAll('.led').forEach(led => { led.style.boxShadow = ''; led.title = ''; });
+                return;
+            }
+            btn.classList.remove('secondary');
+            loadBeamStats();
+            heatTimer = setInterval(loadBeamStats, 2000);
+        }
+
+        function loadBeamStats() {
+            fetch('/api/beamstats').then(r => r.json()).then(s => {
+                let max = 1;
+                for(let d=1; d<=4; d++) s['device'+d].flickerPerMin.forEach(v => max = Math.max(max, v));
+                for(let d=1; d<=4; d++) {
+                    const st = s['device'+d];
+                    st.flickerPerMin.forEach((v, i) => {
+                        const led = document.getElementById(`l-${d}-${i+1}`);
+                        if(!led) return;
+                        led.style.boxShadow = v ? `0 0 0 3px rgba(123,31,162,${(0.2 + 0.8 * v / max).toFixed(2)})` : '';
+                        led.title = `${v} flickers/min, ${st.dropouts[i]} dropouts`;
+                    });
+                }
+            });
+        }
+
+        function shieldNoisy() {
+            const val = parseInt(document.getElementById('flicker-input').value);
+            if(!confirm('Shield all beams above ' + val + ' flickers/min?')) return;
+            fetch('/api/beamstats/shield', { method: 'POST', body: JSON.stringify({ threshold: val }) })
+            .then(r => r.json()).then(res => {
+                fetch('/api/shield').then(r => r.json()).then(d => {
+                    shieldMask = d;
+                    applyShieldMask();
+                });
+                alert(res.changed + ' beams shielded');
+            });
+        }
+
+        function clearAllShielding() {
+            if(!confirm('Clear all shielding points?')) return;
+            fetch('/api/clearShield', { method: 'POST' })
+            .then(r => r.json()).then(res => {
+                shieldMask = {};
+                document.querySelectorAll('.led.shielded').forEach(led => {
+                    led.classList.remove('shielded');
+                });
+                alert('All shielding cleared!');
+            });
+        }
+
+        // 浏览器在非 HTTPS 下没有 crypto.subtle，使用内置 SHA-256
+        function sha256Hex(buf) {
+            const K = [], H = [];
+            for(let c=2, n=0; n<64; c++) {
+                let p = true;
+                for(let d=2; d*d<=c; d++) if(c%d===0) { p = false; break; }
+                if(!p) continue;
+                if(n<8) H[n] = (Math.pow(c, 1/2) * 4294967296) | 0;
+                K[n++] = (Math.pow(c, 1/3) * 4294967296) | 0;
+            }
+            const len = buf.byteLength, total = ((len + 72) >> 6) << 6;
+            const data = new Uint8Array(total);
+            data.set(new Uint8Array(buf)); data[len] = 0x80;
+            const dv = new DataView(data.buffer), W = new Array(64);
+            dv.setUint32(total-8, Math.floor(len / 0x20000000));
+            dv.setUint32(total-4, (len * 8) >>> 0);
+            const ror = (x, n) => (x >>> n) | (x << (32-n));
+            for(let o=0; o<total; o+=64) {
+                let [a,b,c,d,e,f,g,h] = H;
+                for(let i=0; i<64; i++) {
+                    if(i<16) W[i] = dv.getUint32(o + i*4);
+                    else {
+                        const w15 = W[i-15], w2 = W[i-2];
+                        W[i] = (W[i-16] + (ror(w15,7)^ror(w15,18)^(w15>>>3)) + W[i-7] + (ror(w2,17)^ror(w2,19)^(w2>>>10))) | 0;
+                    }
+                    const t1 = (h + (ror(e,6)^ror(e,11)^ror(e,25)) + ((e&f)^(~e&g)) + K[i] + W[i]) | 0;
+                    const t2 = ((ror(a,2)^ror(a,13)^ror(a,22)) + ((a&b)^(a&c)^(b&c))) | 0;
+                    h = g; g = f; f = e; e = (d + t1) | 0; d = c; c = b; b = a; a = (t1 + t2) | 0;
+                }
+                H[0]=(H[0]+a)|0; H[1]=(H[1]+b)|0; H[2]=(H[2]+c)|0; H[3]=(H[3]+d)|0;
+                H[4]=(H[4]+e)|0; H[5]=(H[5]+f)|0; H[6]=(H[6]+g)|0; H[7]=(H[7]+h)|0;
+            }
+            return H.map(x => (x >>> 0).toString(16).padStart(8, '0')).join('');
+        }
+
+        async function doOTA() {
+            const file = document.getElementById('ota-file').files[0];
+            if(!file) return alert('Select file');
+            const buf = await file.arrayBuffer();
+            document.getElementById('ota-status').textContent = 'Hashing...';
+            const digest = sha256Hex(buf);
+            fetch('/update', { method: 'POST', headers: { 'X-Firmware-SHA256': digest }, body: buf }).then(r => {
+                if(r.ok) alert('Update verified, rebooting...');
+                else r.text().then(t => alert('Update failed: ' + t));
+            });
+        }
+
+        init();
+    </script>
+</body>
+</html>
+)rawliteral";
+
+
+LaserWebServer::LaserWebServer() : server(80, WEB_MAX_CLIENTS) {
   lastUpdateTime = 0;
   isWebServerRunning = false;
   clientCount = 0;
+  lastOtaPercent = -1;
+  lastOtaState = OTA_IDLE;
+  bootId = 0;
+  configVersion = 1;
+  for (int i = 0; i < CACHE_COUNT; i++) {
+    responseCache[i].length = 0;
+    responseCache[i].version = 0;
+  }
   baselineDelay = 200; // 默认200ms延迟
   triggerFilterThreshold = 20; // 默认20个点
   shieldingChangeCallback = nullptr;
   clearShieldingCallback = nullptr;
+  shieldingBatchCallback = nullptr;
   triggerFilterCallback = nullptr;
+  zonesCallback = nullptr;
+  calibrationCallback = nullptr;
+  profileCallback = nullptr;
+  zoneCount = 0;
 
   // 初始化所有设备状态为0
   for (int i = 0; i < 4; i++) {
     for (int j = 0; j < 48; j++) {
       deviceStates[i][j] = 0;
     }
-    isSSEClient[i] = false; // 初始化 SSE 标记
+  }
+
+  // 初始化连接池
+  for (int i = 0; i < WEB_MAX_CLIENTS; i++) {
+    slots[i].isSSE = false;
+    slots[i].keepAlive = false;
+    slots[i].lastActivity = 0;
+    slots[i].requestCount = 0;
+    slots[i].phase = REQ_IDLE;
   }
 }
 
 void LaserWebServer::begin() {
+  bootId = esp_random();
   server.begin();
+  server.setNoDelay(true);
   isWebServerRunning = true;
   Serial.println("Web服务器已启动");
   Serial.print("访问地址: http://");
   Serial.println(WiFi.localIP());
+  Serial.printf("连接池: %d 槽位 (SSE 上限 %d, REST 上限 %d, keep-alive %dms)\n",
+                WEB_MAX_CLIENTS, WEB_MAX_SSE_CLIENTS, WEB_MAX_HTTP_CLIENTS,
+                WEB_KEEPALIVE_TIMEOUT_MS);
+}
+
+void LaserWebServer::releaseSlot(ClientSlot &slot) {
+  slot.client.stop();
+  slot.isSSE = false;
+  slot.keepAlive = false;
+  slot.requestCount = 0;
+  slot.phase = REQ_IDLE;
+  slot.req.body = String();
+  if (clientCount > 0)
+    clientCount--;
+}
+
+// 把 socket 所有权交给其他任务 (如 OTA)，不关闭连接
+void LaserWebServer::detachSlot(ClientSlot &slot) {
+  slot.client = WiFiClient();
+  slot.isSSE = false;
+  slot.keepAlive = false;
+  slot.requestCount = 0;
+  slot.phase = REQ_IDLE;
+  slot.req.body = String();
+  if (clientCount > 0)
+    clientCount--;
+}
+
+int LaserWebServer::countSlots(bool sse) {
+  int count = 0;
+  for (int i = 0; i < WEB_MAX_CLIENTS; i++) {
+    if (slots[i].client && slots[i].client.connected() &&
+        slots[i].isSSE == sse)
+      count++;
+  }
+  return count;
+}
+
+// 找到最久未活动、且当前没有待处理数据或半读请求的 keep-alive REST 连接
+int LaserWebServer::findEvictableSlot() {
+  int victim = -1;
+  unsigned long oldest = 0;
+  unsigned long now = millis();
+  for (int i = 0; i < WEB_MAX_CLIENTS; i++) {
+    ClientSlot &slot = slots[i];
+    if (!slot.client || slot.isSSE || slot.phase != REQ_IDLE ||
+        slot.client.available())
+      continue;
+    unsigned long idle = now - slot.lastActivity;
+    if (victim < 0 || idle > oldest) {
+      victim = i;
+      oldest = idle;
+    }
+  }
+  return victim;
 }
 
 void LaserWebServer::handleClient() {
-  // 清理断开的客户端
-  for (int i = 0; i < 4; i++) {
-    if (clients[i]) {
-      if (!clients[i].connected()) {
-        Serial.printf("Client %d disconnected\n", i);
-        clients[i].stop();
-        isSSEClient[i] = false;
-        if (clientCount > 0)
-          clientCount--;
-      } else if (clients[i].available() && !isSSEClient[i]) {
-        // 只处理非 SSE 客户端的新请求
-        handleHTTPRequest(clients[i], i);
-      }
+  unsigned long now = millis();
+
+  // 清理断开/空闲超时的客户端，并处理 REST 连接上的新请求
+  for (int i = 0; i < WEB_MAX_CLIENTS; i++) {
+    ClientSlot &slot = slots[i];
+    if (!slot.client)
+      continue;
+
+    if (!slot.client.connected()) {
+      Serial.printf("Client %d disconnected\n", i);
+      releaseSlot(slot);
+    } else if (slot.isSSE) {
+      // SSE 连接只写不读
+      continue;
+    } else if (slot.phase != REQ_IDLE &&
+               now - slot.requestStart > WEB_REQUEST_TIMEOUT_MS) {
+      // 请求未在时限内到齐 (慢速/不完整客户端)
+      if (slot.phase == REQ_BODY)
+        ResponseWriter(slot.client, false).sendError(400, "Bad Request");
+      releaseSlot(slot);
+    } else if (slot.client.available()) {
+      handleHTTPRequest(slot);
+    } else if (slot.phase == REQ_IDLE &&
+               now - slot.lastActivity > WEB_KEEPALIVE_TIMEOUT_MS) {
+      releaseSlot(slot);
     }
   }
 
-  // 检查新客户端连接
+  acceptNewClient();
+  broadcastOtaProgress();
+}
+
+void LaserWebServer::acceptNewClient() {
   WiFiClient newClient = server.available();
-  if (newClient) {
-    // 找到空槽位
-    int freeSlot = -1;
-    for (int i = 0; i < 4; i++) {
-      if (!clients[i] || !clients[i].connected()) {
-        freeSlot = i;
-        break;
-      }
+  if (!newClient)
+    return;
+
+  // 找到空槽位
+  int freeSlot = -1;
+  for (int i = 0; i < WEB_MAX_CLIENTS; i++) {
+    if (!slots[i].client || !slots[i].client.connected()) {
+      if (slots[i].client)
+        releaseSlot(slots[i]);
+      freeSlot = i;
+      break;
     }
+  }
 
-    if (freeSlot >= 0) {
-      // 打印客户端 IP 地址用于调试
-      IPAddress clientIP = newClient.remoteIP();
-      Serial.printf("New client connected from %s, stored in slot %d\n",
-                    clientIP.toString().c_str(), freeSlot);
-      clients[freeSlot] = newClient;
-      isSSEClient[freeSlot] = false;
-      clientCount++;
-    } else {
-      // 限流：只每5秒打印一次"No free slots"警告
-      static unsigned long lastNoSlotWarning = 0;
-      unsigned long currentTime = millis();
-      if (currentTime - lastNoSlotWarning > 5000) {
-        Serial.println("No free slots available:");
-        for (int i = 0; i < 4; i++) {
-          if (clients[i].connected()) {
-            Serial.printf("  Slot %d: connected=%d, SSE=%d, IP=%s\n", i,
-                          clients[i].connected(), isSSEClient[i],
-                          clients[i].remoteIP().toString().c_str());
-          }
-        }
-        lastNoSlotWarning = currentTime;
+  // 接入时还不知道是 REST 还是 SSE，只要池中有槽位就接受；
+  // 两类各自的上限在请求头读完、路由确定后检查 (routeRequest / handleEvents)。
+  // 池满时回收最久空闲的 keep-alive 连接
+  if (freeSlot < 0) {
+    freeSlot = findEvictableSlot();
+    if (freeSlot >= 0)
+      releaseSlot(slots[freeSlot]);
+  }
+
+  if (freeSlot >= 0) {
+    IPAddress clientIP = newClient.remoteIP();
+    Serial.printf("New client connected from %s, stored in slot %d\n",
+                  clientIP.toString().c_str(), freeSlot);
+    newClient.setNoDelay(true);
+    ClientSlot &slot = slots[freeSlot];
+    slot.client = newClient;
+    slot.isSSE = false;
+    slot.keepAlive = false;
+    slot.requestCount = 0;
+    slot.phase = REQ_IDLE;
+    slot.lastActivity = millis();
+    clientCount++;
+  } else {
+    // 限流：只每5秒打印一次"No free slots"警告
+    static unsigned long lastNoSlotWarning = 0;
+    unsigned long currentTime = millis();
+    if (currentTime - lastNoSlotWarning > 5000) {
+      Serial.println("No free slots available:");
+      for (int i = 0; i < WEB_MAX_CLIENTS; i++) {
+        if (slots[i].client.connected()) {
+          Serial.printf("  Slot %d: connected=%d, SSE=%d, IP=%s\n", i,
+                        slots[i].client.connected(), slots[i].isSSE,
+                        slots[i].client.remoteIP().toString().c_str());
+        }
       }
-      newClient.stop();
+      lastNoSlotWarning = currentTime;
     }
+    ResponseWriter(newClient, false).sendError(503, "Service Unavailable");
+    newClient.stop();
   }
 }
 
@@ -103,60 +710,165 @@ void LaserWebServer::updateAllDeviceStates(uint8_t deviceAddr,
 }
 
 void LaserWebServer::broadcastStates() {
-  String json = getDeviceStatesJSON();
-  for (int i = 0; i < 4; i++) {
-    if (clients[i].connected() && isSSEClient[i]) {
+  TRACE_SCOPE("sse.broadcast");
+  for (int i = 0; i < WEB_MAX_CLIENTS; i++) {
+    ClientSlot &slot = slots[i];
+    if (slot.isSSE && slot.client.connected()) {
       // 尝试发送数据
-      size_t written = clients[i].print("data: ");
+      size_t written = slot.client.print("data: ");
       if (written == 0) {
         // 写入失败，连接可能已断开
         Serial.printf(
             "Failed to write to SSE client on slot %d, closing connection\n",
             i);
-        clients[i].stop();
-        isSSEClient[i] = false;
-        if (clientCount > 0)
-          clientCount--;
+        releaseSlot(slot);
         continue;
       }
-      clients[i].print(json);
-      clients[i].print("\n\n");
-      clients[i].flush();
+      BufferedPrint out(slot.client);
+      writeDeviceStatesJSON(out, 0);
+      out.print("\n\n");
+      out.flush();
+      metrics.sseBytes.inc(written + out.bytesWritten());
+      slot.lastActivity = millis();
     }
   }
 }
 
-String LaserWebServer::getDeviceStatesJSON() {
-  DynamicJsonDocument doc(8192);
+// 发送带事件名的 SSE 消息 (前端通过 addEventListener(event) 接收)
+void LaserWebServer::broadcastEvent(const char *event, const char *data) {
+  for (int i = 0; i < WEB_MAX_CLIENTS; i++) {
+    ClientSlot &slot = slots[i];
+    if (slot.isSSE && slot.client.connected()) {
+      size_t written = slot.client.print("event: ");
+      written += slot.client.print(event);
+      written += slot.client.print("\ndata: ");
+      written += slot.client.print(data);
+      written += slot.client.print("\n\n");
+      metrics.sseBytes.inc(written);
+      slot.lastActivity = millis();
+    }
+  }
+}
 
-  for (int device = 1; device <= 4; device++) {
-    String deviceKey = "device" + String(device);
-    JsonArray inputs = doc.createNestedArray(deviceKey);
+// OTA 进度在百分比或状态变化时通过 SSE 推送
+void LaserWebServer::broadcastOtaProgress() {
+  OtaState state = ota.getState();
+  int percent = ota.getPercent();
+  if (state == lastOtaState && percent == lastOtaPercent)
+    return;
+  lastOtaState = state;
+  lastOtaPercent = percent;
 
+  char json[160];
+  snprintf(json, sizeof(json),
+           "{\"state\":\"%s\",\"received\":%u,\"total\":%u,\"percent\":%d,"
+           "\"error\":\"%s\"}",
+           ota.getStateName(), (unsigned)ota.getReceived(),
+           (unsigned)ota.getTotal(), percent, ota.getError());
+  broadcastEvent("ota", json);
+}
+
+// 直接流式输出，与原 ArduinoJson 序列化格式一致:
+// {"device1":[{"id":1,"state":0},...],...}
+void LaserWebServer::writeDeviceStatesJSON(Print &out, int onlyDevice) {
+  out.print('{');
+  bool firstDevice = true;
+  for (int device = 1; device <= 4; device++) {
+    if (onlyDevice != 0 && device != onlyDevice)
+      continue;
+    if (!firstDevice)
+      out.print(',');
+    firstDevice = false;
+    out.printf("\"device%d\":[", device);
     for (int input = 1; input <= 48; input++) {
-      JsonObject inputObj = inputs.createNestedObject();
-      inputObj["id"] = input;
-      inputObj["state"] = deviceStates[device - 1][input - 1];
+      out.printf("%s{\"id\":%d,\"state\":%d}", input > 1 ? "," : "", input,
+                 deviceStates[device - 1][input - 1]);
     }
+    out.print(']');
   }
+  out.print('}');
+}
+
+void LaserWebServer::invalidateResponseCache() { configVersion++; }
 
-  String output;
-  serializeJson(doc, output);
-  return output;
+// 配置类 GET：版本未变时直接一次 write() 缓存的完整响应；
+// If-None-Match 命中时只回 304。
+void LaserWebServer::sendCached(ClientSlot &slot, HttpRequest &req,
+                                ResponseCacheId id) {
+  CachedResponse &entry = responseCache[id];
+  if (entry.version != configVersion) {
+    snprintf(entry.etag, sizeof(entry.etag), "\"%08x-%u\"", bootId,
+             configVersion);
+    entry.version = configVersion;
+    entry.length = 0;
+  }
+
+  ResponseWriter writer(slot.client, req.keepAlive);
+  if (req.method == METHOD_GET && strcmp(req.ifNoneMatch, entry.etag) == 0) {
+    writer.sendHeaders(304, "application/json", 0, entry.etag);
+    return;
+  }
+
+  if (entry.length == 0 || entry.keepAlive != req.keepAlive) {
+    // 先计数得到正文长度，再把头和正文渲染进缓存缓冲
+    CountingPrint counter;
+    writeCachedBody(counter, id);
+    size_t headerLen = ResponseWriter::formatHeaders(
+        entry.data, sizeof(entry.data), 200, "application/json",
+        counter.length(), req.keepAlive, entry.etag);
+    FixedBufferPrint body(entry.data + headerLen,
+                          sizeof(entry.data) - headerLen);
+    if (headerLen > 0)
+      writeCachedBody(body, id);
+    if (headerLen == 0 || body.overflowed()) {
+      // 超出缓存容量，退回直接流式输出
+      entry.length = 0;
+      writer.sendGenerated("application/json", [this, id](Print &out) {
+        writeCachedBody(out, id);
+      });
+      return;
+    }
+    entry.length = headerLen + body.length();
+    entry.keepAlive = req.keepAlive;
+  }
+
+  slot.client.write((const uint8_t *)entry.data, entry.length);
+}
+
+void LaserWebServer::writeCachedBody(Print &out, ResponseCacheId id) {
+  switch (id) {
+  case CACHE_SHIELD_MASK:
+    writeShieldMaskJSON(out);
+    break;
+  case CACHE_BASELINE_DELAY:
+    out.printf("{\"delay\":%lu}", baselineDelay);
+    break;
+  default:
+    out.printf("{\"threshold\":%d}", triggerFilterThreshold);
+    break;
+  }
 }
 
-String LaserWebServer::getHTTPResponse(const String &contentType,
-                                       const String &content) {
-  String response = "HTTP/1.1 200 OK\r\n";
-  response += "Content-Type: " + contentType + "\r\n";
-  response += "Access-Control-Allow-Origin: *\r\n";
-  response += "Access-Control-Allow-Methods: GET, POST, OPTIONS\r\n";
-  response += "Access-Control-Allow-Headers: Content-Type\r\n";
-  response += "Connection: close\r\n";
-  response += "Content-Length: " + String(content.length()) + "\r\n";
-  response += "\r\n";
-  response += content;
-  return response;
+// 按 Content-Length 精确读取请求体，保证 keep-alive 连接上的下一个请求不被污染。
+// 只读取已到达的数据，读完返回 true；未读完留待下一次 handleClient()
+bool LaserWebServer::readRequestBody(ClientSlot &slot) {
+  HttpRequest &req = slot.req;
+  uint8_t buf[256];
+  while (req.body.length() < req.contentLength) {
+    int avail = slot.client.available();
+    if (avail <= 0)
+      return false;
+    size_t want = req.contentLength - req.body.length();
+    if (want > (size_t)avail)
+      want = avail;
+    if (want > sizeof(buf))
+      want = sizeof(buf);
+    int n = slot.client.read(buf, want);
+    if (n <= 0)
+      return false;
+    req.body.concat((const char *)buf, n);
+  }
+  return true;
 }
 
 void LaserWebServer::sendWebSocketUpdate(WiFiClient &client,
@@ -170,450 +882,892 @@ void LaserWebServer::sendWebSocketUpdate(WiFiClient &client,
   }
 }
 
-void LaserWebServer::handleHTTPRequest(WiFiClient &client, int slotIndex) {
-  String request = "";
-  size_t contentLength = 0;
-  // 读取请求行和头部
-  while (client.connected()) {
-    if (client.available()) {
-      String line = client.readStringUntil('\n');
-      request += line;
+// ============== 路由表 ==============
+// 必须按 (pattern, method) 字典序排列，编译期 static_assert 校验。
+// 新增接口只需在此登记一行，查找代价为 O(log n)。
+constexpr LaserWebServer::Route LaserWebServer::routes[] = {
+    {METHOD_GET, "/", &LaserWebServer::handleIndex, false},
+    {METHOD_GET, "/api/availability", &LaserWebServer::handleGetAvailability, false},
+    {METHOD_GET, "/api/baselineDelay", &LaserWebServer::handleGetBaselineDelay, false},
+    {METHOD_POST, "/api/baselineDelay", &LaserWebServer::handlePostBaselineDelay, false},
+    {METHOD_GET, "/api/beamstats", &LaserWebServer::handleGetBeamStats, false},
+    {METHOD_POST, "/api/beamstats/reset", &LaserWebServer::handlePostBeamStatsReset, false},
+    {METHOD_POST, "/api/beamstats/shield", &LaserWebServer::handlePostBeamStatsShield, false},
+    {METHOD_GET, "/api/calibration", &LaserWebServer::handleGetCalibration, false},
+    {METHOD_POST, "/api/calibration", &LaserWebServer::handlePostCalibration, false},
+    {METHOD_POST, "/api/clearShield", &LaserWebServer::handleClearShield, false},
+    {METHOD_GET, "/api/config", &LaserWebServer::handleGetConfig, false},
+    {METHOD_POST, "/api/config", &LaserWebServer::handlePostConfig, false},
+    {METHOD_POST, "/api/config/save", &LaserWebServer::handlePostConfigSave, false},
+    {METHOD_GET, "/api/perf", &LaserWebServer::handleGetPerf, false},
+    {METHOD_GET, "/api/perf/raw", &LaserWebServer::handleGetPerfRaw, false},
+    {METHOD_POST, "/api/perf/reset", &LaserWebServer::handlePostPerfReset, false},
+    {METHOD_GET, "/api/profiles", &LaserWebServer::handleGetProfiles, false},
+    {METHOD_POST, "/api/profiles", &LaserWebServer::handlePostProfiles, false},
+    {METHOD_POST, "/api/profiles/activate", &LaserWebServer::handlePostProfileActivate, false},
+    {METHOD_POST, "/api/profiles/delete", &LaserWebServer::handlePostProfileDelete, false},
+    {METHOD_GET, "/api/shield", &LaserWebServer::handleGetShield, false},
+    {METHOD_POST, "/api/shield", &LaserWebServer::handlePostShield, false},
+    {METHOD_POST, "/api/shield/batch", &LaserWebServer::handlePostShieldBatch, false},
+    {METHOD_GET, "/api/states", &LaserWebServer::handleGetStates, false},
+    {METHOD_GET, "/api/states/:device", &LaserWebServer::handleGetDeviceStates, false},
+    {METHOD_GET, "/api/trace", &LaserWebServer::handleGetTrace, false},
+    {METHOD_GET, "/api/triggerFilter", &LaserWebServer::handleGetTriggerFilter, false},
+    {METHOD_POST, "/api/triggerFilter", &LaserWebServer::handlePostTriggerFilter, false},
+    {METHOD_GET, "/api/zones", &LaserWebServer::handleGetZones, false},
+    {METHOD_POST, "/api/zones", &LaserWebServer::handlePostZones, false},
+    {METHOD_GET, "/events", &LaserWebServer::handleEvents, false},
+    {METHOD_GET, "/index.html", &LaserWebServer::handleIndex, false},
+    {METHOD_GET, "/metrics", &LaserWebServer::handleMetrics, false},
+    {METHOD_POST, "/update", &LaserWebServer::handleUpdate, true},
+};
+constexpr size_t LaserWebServer::routeCount =
+    sizeof(LaserWebServer::routes) / sizeof(LaserWebServer::routes[0]);
 
-      // 解析 Content-Length (不区分大小写)
-      String lowerLine = line;
-      lowerLine.toLowerCase();
-      if (lowerLine.startsWith("content-length: ")) {
-        contentLength = lowerLine.substring(16).toInt();
-      }
+static constexpr int routeCompare(const char *a, const char *b) {
+  return (*a != *b || *a == '\0') ? (int)(unsigned char)*a - (int)(unsigned char)*b
+                                  : routeCompare(a + 1, b + 1);
+}
 
-      if (line == "\r" || line == "")
-        break;
+constexpr bool LaserWebServer::routesSortedFrom(size_t i) {
+  return i + 1 >= routeCount ||
+         ((routeCompare(routes[i].pattern, routes[i + 1].pattern) < 0 ||
+           (routeCompare(routes[i].pattern, routes[i + 1].pattern) == 0 &&
+            routes[i].method < routes[i + 1].method)) &&
+          routesSortedFrom(i + 1));
+}
+
+// 把已到达的字节追加到槽位行缓冲 (去掉行尾 \r\n，过长部分丢弃)；
+// 读到整行返回行长并清空缓冲计数，数据不足返回 -1
+static int readRequestLine(ClientSlot &slot) {
+  while (slot.client.available()) {
+    char c = (char)slot.client.read();
+    if (c == '\n') {
+      int len = slot.lineLen;
+      slot.line[len] = '\0';
+      slot.lineLen = 0;
+      return len;
     }
+    if (c != '\r' && (size_t)slot.lineLen + 1 < sizeof(slot.line))
+      slot.line[slot.lineLen++] = c;
   }
+  return -1;
+}
+
+// 复制请求头的值 (跳过前导空白)
+static void copyHeaderValue(const char *value, char *out, size_t outLen) {
+  while (*value == ' ' || *value == '\t')
+    value++;
+  strlcpy(out, value, outLen);
+}
+
+// 新请求的首字节到达：重置槽位中的解析状态并开始计时
+void LaserWebServer::startRequest(ClientSlot &slot) {
+  HttpRequest &req = slot.req;
+  req.method = METHOD_UNKNOWN;
+  req.path[0] = '\0';
+  req.query[0] = '\0';
+  req.contentLength = 0;
+  req.keepAlive = false;
+  req.firmwareSha256[0] = '\0';
+  req.ifNoneMatch[0] = '\0';
+  req.body = "";
+  req.paramCount = 0;
+
+  slot.phase = REQ_LINE;
+  slot.requestStart = millis();
+  slot.lineLen = 0;
+  slot.connectionHeader = 0;
+  slot.isHTTP10 = false;
+  slot.route = -1;
+}
+
+// 请求行: "GET /path?query HTTP/1.1"
+bool LaserWebServer::parseRequestLine(ClientSlot &slot) {
+  HttpRequest &req = slot.req;
+  char *line = slot.line;
+  char *target = strchr(line, ' ');
+  char *version = target != nullptr ? strchr(target + 1, ' ') : nullptr;
+  if (target == nullptr || version == nullptr)
+    return false;
+  *target++ = '\0';
+  *version++ = '\0';
 
-  // 解析HTTP请求
-  if (request.indexOf("GET / ") >= 0 ||
-      request.indexOf("GET /index.html") >= 0) {
-    String html = getHTMLPage();
-    client.print(getHTTPResponse("text/html", html));
-    client.stop();
-    isSSEClient[slotIndex] = false;
-  } else if (request.indexOf("GET /api/states") >= 0) {
-    String json = getDeviceStatesJSON();
-    client.print(getHTTPResponse("application/json", json));
-    client.stop();
-    isSSEClient[slotIndex] = false;
-  } else if (request.indexOf("GET /api/shield") >= 0) {
-    String json = getShieldMaskJSON();
-    client.print(getHTTPResponse("application/json", json));
-    client.stop();
-    isSSEClient[slotIndex] = false;
-  } else if (request.indexOf("POST /api/shield") >= 0) {
-    // 简化的 Body 读取
-    String body = "";
-    while (client.available())
-      body += (char)client.read();
-
-    DynamicJsonDocument doc(256);
-    if (deserializeJson(doc, body) == DeserializationError::Ok) {
-      if (doc.containsKey("device") && doc.containsKey("id") &&
-          doc.containsKey("state")) {
-        setShieldState(doc["device"], doc["id"], doc["state"]);
-        client.print(
-            getHTTPResponse("application/json", "{\"status\":\"ok\"}"));
+  if (strcmp(line, "GET") == 0)
+    req.method = METHOD_GET;
+  else if (strcmp(line, "POST") == 0)
+    req.method = METHOD_POST;
+  else if (strcmp(line, "OPTIONS") == 0)
+    req.method = METHOD_OPTIONS;
+
+  char *query = strchr(target, '?');
+  if (query != nullptr) {
+    *query++ = '\0';
+    strlcpy(req.query, query, sizeof(req.query));
+  }
+  strlcpy(req.path, target, sizeof(req.path));
+  slot.isHTTP10 = strcmp(version, "HTTP/1.0") == 0;
+  return true;
+}
+
+// 请求头 (不区分大小写)
+void LaserWebServer::parseHeaderLine(ClientSlot &slot) {
+  HttpRequest &req = slot.req;
+  const char *line = slot.line;
+  if (strncasecmp(line, "content-length:", 15) == 0) {
+    req.contentLength = strtoul(line + 15, nullptr, 10);
+  } else if (strncasecmp(line, "connection:", 11) == 0) {
+    slot.connectionHeader = strcasestr(line + 11, "close") != nullptr ? 1 : 2;
+  } else if (strncasecmp(line, "if-none-match:", 14) == 0) {
+    copyHeaderValue(line + 14, req.ifNoneMatch, sizeof(req.ifNoneMatch));
+  } else if (strncasecmp(line, "x-firmware-sha256:", 18) == 0) {
+    copyHeaderValue(line + 18, req.firmwareSha256,
+                    sizeof(req.firmwareSha256));
+  }
+}
+
+// 从查询串中取出 name=value (不做 URL 解码)
+bool HttpRequest::queryParam(const char *name, char *out, size_t outLen) const {
+  size_t nameLen = strlen(name);
+  const char *p = query;
+  while (*p) {
+    if (strncmp(p, name, nameLen) == 0 && p[nameLen] == '=') {
+      p += nameLen + 1;
+      size_t len = 0;
+      while (*p && *p != '&') {
+        if (len + 1 < outLen)
+          out[len++] = *p;
+        p++;
+      }
+      out[len] = '\0';
+      return true;
+    }
+    p = strchr(p, '&');
+    if (p == nullptr)
+      break;
+    p++;
+  }
+  return false;
+}
+
+// 逐段匹配，':' 开头的段捕获为路径参数
+bool LaserWebServer::matchPattern(const char *pattern, const char *path,
+                                  HttpRequest &req) {
+  req.paramCount = 0;
+  while (*pattern && *path) {
+    if (*pattern == ':') {
+      if (req.paramCount >= HTTP_MAX_PATH_PARAMS)
+        return false;
+      char *out = req.params[req.paramCount++];
+      size_t len = 0;
+      while (*path && *path != '/') {
+        if (len + 1 < HTTP_MAX_PARAM_LEN)
+          out[len++] = *path;
+        path++;
       }
+      out[len] = '\0';
+      if (len == 0)
+        return false;
+      while (*pattern && *pattern != '/')
+        pattern++;
+    } else if (*pattern++ != *path++) {
+      return false;
     }
-    client.stop();
-    isSSEClient[slotIndex] = false;
-  } else if (request.indexOf("POST /api/clearShield") >= 0) {
-    // 清空所有屏蔽点
-    clearShielding();
-    client.print(getHTTPResponse("application/json", "{\"status\":\"ok\",\"message\":\"All shielding cleared\"}"));
-    client.stop();
-    isSSEClient[slotIndex] = false;
-  } else if (request.indexOf("GET /api/baselineDelay") >= 0) {
-    String json = getBaselineDelayJSON();
-    client.print(getHTTPResponse("application/json", json));
-    client.stop();
-    isSSEClient[slotIndex] = false;
-  } else if (request.indexOf("POST /api/baselineDelay") >= 0) {
-    String body = "";
-    while (client.available())
-      body += (char)client.read();
-    DynamicJsonDocument doc(256);
-    if (deserializeJson(doc, body) == DeserializationError::Ok) {
-      setBaselineDelay(doc["delay"]);
-      client.print(getHTTPResponse("application/json", getBaselineDelayJSON()));
+  }
+  return *pattern == '\0' && *path == '\0';
+}
+
+const LaserWebServer::Route *LaserWebServer::findRoute(HttpRequest &req,
+                                                       bool &pathMatched) {
+  static_assert(routesSortedFrom(0),
+                "LaserWebServer::routes must be sorted by pattern, method");
+
+  // 二分查找第一个 pattern >= key 的路由
+  auto lowerBound = [](const char *key) -> size_t {
+    size_t lo = 0, hi = routeCount;
+    while (lo < hi) {
+      size_t mid = (lo + hi) / 2;
+      if (strcmp(routes[mid].pattern, key) < 0)
+        lo = mid + 1;
+      else
+        hi = mid;
     }
-    client.stop();
-    isSSEClient[slotIndex] = false;
-  } else if (request.indexOf("GET /api/triggerFilter") >= 0) {
-    String json = getTriggerFilterJSON();
-    client.print(getHTTPResponse("application/json", json));
-    client.stop();
-    isSSEClient[slotIndex] = false;
-  } else if (request.indexOf("POST /api/triggerFilter") >= 0) {
-    String body = "";
-    while (client.available())
-      body += (char)client.read();
-    DynamicJsonDocument doc(256);
-    if (deserializeJson(doc, body) == DeserializationError::Ok) {
-      int threshold = doc["threshold"];
-      triggerFilterThreshold = threshold;
-      if (triggerFilterCallback != nullptr) {
-        triggerFilterCallback(threshold);
+    return lo;
+  };
+
+  pathMatched = false;
+  req.paramCount = 0;
+
+  // 1. 精确匹配
+  for (size_t i = lowerBound(req.path);
+       i < routeCount && strcmp(routes[i].pattern, req.path) == 0; i++) {
+    pathMatched = true;
+    if (routes[i].method == req.method)
+      return &routes[i];
+  }
+  if (pathMatched)
+    return nullptr;
+
+  // 2. 参数路由：从最深的 '/' 开始，查找 "<前缀>/:" 开头的 pattern
+  char prefix[HTTP_MAX_PATH_LEN + 2];
+  for (int cut = (int)strlen(req.path) - 1; cut >= 0; cut--) {
+    if (req.path[cut] != '/')
+      continue;
+    memcpy(prefix, req.path, cut + 1);
+    prefix[cut + 1] = ':';
+    prefix[cut + 2] = '\0';
+    for (size_t i = lowerBound(prefix);
+         i < routeCount && strncmp(routes[i].pattern, prefix, cut + 2) == 0;
+         i++) {
+      if (matchPattern(routes[i].pattern, req.path, req)) {
+        pathMatched = true;
+        if (routes[i].method == req.method)
+          return &routes[i];
       }
-      client.print(getHTTPResponse("application/json", getTriggerFilterJSON()));
     }
-    client.stop();
-    isSSEClient[slotIndex] = false;
-  } else if (request.indexOf("POST /update") >= 0) {
-    // OTA Update handler
-    if (contentLength > 0) {
-      Serial.printf("Starting OTA Update... Size: %u bytes\n", contentLength);
-      if (Update.begin(contentLength)) {
-        size_t written = Update.writeStream(client);
-        if (written == contentLength) {
-          Serial.printf("Written : %u successfully\n", written);
-        } else {
-          Serial.printf("Written only : %u/%u. Fail?\n", written,
-                        contentLength);
-        }
-
-        if (Update.end()) {
-          Serial.println("OTA Update Success!");
-          if (Update.isFinished()) {
-            Serial.println("Update successfully completed. Rebooting...");
-            client.print(getHTTPResponse("text/plain", "OK"));
-            client.stop();
-            delay(100);
-            ESP.restart();
-          } else {
-            Serial.println("Update not finished? Something went wrong!");
-            client.print(
-                getHTTPResponse("text/plain", "Update Finished Error"));
-          }
-        } else {
-          Serial.printf("Update Error Occurred. Error #: %u\n",
-                        Update.getError());
-          client.print(getHTTPResponse(
-              "text/plain", "Update Error: " + String(Update.getError())));
-        }
-      } else {
-        Serial.println("Not enough space to begin OTA");
-        client.print(getHTTPResponse("text/plain", "Not enough space"));
+    if (pathMatched)
+      return nullptr;
+  }
+  return nullptr;
+}
+
+// 每次 handleClient() 只消费该连接上已到达的数据：请求行/请求头/请求体
+// 跨轮次累积在槽位中，不在半包上自旋等待，扫描循环不会被慢速客户端拖住
+void LaserWebServer::handleHTTPRequest(ClientSlot &slot) {
+  TRACE_SCOPE("http.request");
+  if (slot.phase == REQ_IDLE)
+    startRequest(slot);
+
+  while (slot.phase == REQ_LINE || slot.phase == REQ_HEADERS) {
+    int len = readRequestLine(slot);
+    if (len < 0)
+      return; // 行未到齐，下一轮继续
+    if (slot.phase == REQ_LINE) {
+      if (len == 0 || !parseRequestLine(slot)) {
+        releaseSlot(slot);
+        return;
       }
+      slot.phase = REQ_HEADERS;
+    } else if (len > 0) {
+      parseHeaderLine(slot);
+    } else if (!routeRequest(slot)) {
+      return; // 已响应 (OPTIONS/404/405) 或已分发
+    }
+  }
+
+  if (slot.phase == REQ_BODY && readRequestBody(slot))
+    dispatchRequest(slot);
+}
+
+// 请求头读完：处理预检、匹配路由。需要读取请求体时进入 REQ_BODY 并返回 true
+bool LaserWebServer::routeRequest(ClientSlot &slot) {
+  HttpRequest &req = slot.req;
+
+  // HTTP/1.1 默认持久连接；HTTP/1.0 需显式声明 keep-alive
+  req.keepAlive = slot.connectionHeader == 2 ||
+                  (slot.connectionHeader == 0 && !slot.isHTTP10);
+  slot.requestCount++;
+  slot.lastActivity = millis();
+  req.keepAlive =
+      req.keepAlive && slot.requestCount < WEB_KEEPALIVE_MAX_REQUESTS;
+
+  if (req.method == METHOD_OPTIONS) {
+    // CORS 预检
+    ResponseWriter(slot.client, req.keepAlive).send(204, "text/plain", "");
+    finishRequest(slot);
+    return false;
+  }
+
+  bool pathMatched = false;
+  const Route *route = findRoute(req, pathMatched);
+  if (route == nullptr) {
+    ResponseWriter(slot.client, false)
+        .sendError(pathMatched ? 405 : 404,
+                   pathMatched ? "Method Not Allowed" : "Not Found");
+    releaseSlot(slot);
+    return false;
+  }
+  slot.route = route - routes;
+
+  // REST 上限 (含本连接)：先回收空闲的 keep-alive 连接，仍超出则拒绝；
+  // /events 的上限由 handleEvents 按 SSE 连接数单独检查
+  if (route->handler != &LaserWebServer::handleEvents &&
+      countSlots(false) > WEB_MAX_HTTP_CLIENTS) {
+    int victim = findEvictableSlot();
+    if (victim >= 0) {
+      releaseSlot(slots[victim]);
     } else {
-      client.print(getHTTPResponse("text/plain", "No Content?"));
+      ResponseWriter(slot.client, false)
+          .sendError(503, "Too many REST clients");
+      releaseSlot(slot);
+      return false;
     }
-    client.stop();
-    isSSEClient[slotIndex] = false;
-  } else if (request.indexOf("GET /events") >= 0) {
-    String response = "HTTP/1.1 200 OK\r\n";
-    response += "Content-Type: text/event-stream\r\n";
-    response += "Cache-Control: no-cache\r\n";
-    response += "Connection: keep-alive\r\n";
-    response += "Access-Control-Allow-Origin: *\r\n\r\n";
-    client.print(response);
-    client.flush();
-    isSSEClient[slotIndex] = true;
+  }
+
+  // OTA 自行流式读取请求体，其余接口先按 Content-Length 读完
+  if (route->streamBody || req.contentLength == 0) {
+    dispatchRequest(slot);
+    return false;
+  }
+  if (req.contentLength > WEB_MAX_BODY_SIZE) {
+    ResponseWriter(slot.client, false).sendError(400, "Bad Request");
+    releaseSlot(slot);
+    return false;
+  }
+  req.body.reserve(req.contentLength);
+  slot.phase = REQ_BODY;
+  return true;
+}
+
+void LaserWebServer::dispatchRequest(ClientSlot &slot) {
+  (this->*routes[slot.route].handler)(slot, slot.req);
+  finishRequest(slot);
+}
+
+// 响应完成后决定保持还是关闭连接
+void LaserWebServer::finishRequest(ClientSlot &slot) {
+  slot.phase = REQ_IDLE;
+  if (slot.isSSE || !slot.client)
+    return; // SSE 长连接，或 socket 已移交给 OTA 任务
+  slot.req.body = String();
+  slot.keepAlive = slot.req.keepAlive;
+  if (slot.keepAlive) {
+    slot.lastActivity = millis();
   } else {
-    client.print(getHTTPResponse("text/html", "404 Not Found"));
-    client.stop();
-    isSSEClient[slotIndex] = false;
-  }
-}
-
-String LaserWebServer::getHTMLPage() {
-  String html = "";
-  html += "<!DOCTYPE html>\n";
-  html += "<html lang=\"en\">\n";
-  html += "<head>\n";
-  html += "    <meta charset=\"UTF-8\">\n";
-  html += "    <meta name=\"viewport\" content=\"width=device-width, "
-          "initial-scale=1.0\">\n";
-  html += "    <title>Laser Sensor Monitoring</title>\n";
-  html += "    <style>\n";
-  html += "        body { font-family: sans-serif; margin: 0; padding: 20px; "
-          "background: #f0f2f5; }\n";
-  html += "        .container { max-width: 1200px; margin: 0 auto; background: "
-          "white; padding: 20px; border-radius: 12px; box-shadow: 0 4px 6px "
-          "rgba(0,0,0,0.1); }\n";
-  html += "        .header { display: flex; justify-content: space-between; "
-          "align-items: center; margin-bottom: 20px; }\n";
-  html +=
-      "        .status-bar { background: #e3f2fd; padding: 10px 20px; "
-      "border-radius: 8px; margin-bottom: 20px; display: flex; gap: 20px; }\n";
-  html += "        .control-panel { background: #f8f9fa; padding: 15px; "
-          "border-radius: 8px; margin-bottom: 20px; display: flex; flex-wrap: "
-          "wrap; gap: 15px; align-items: center; }\n";
-  html += "        .device-grid { display: grid; grid-template-columns: "
-          "repeat(auto-fit, minmax(500px, 1fr)); gap: 20px; }\n";
-  html += "        .device-card { border: 1px solid #dee2e6; border-radius: "
-          "10px; padding: 15px; background: #fff; }\n";
-  html += "        .device-title { font-size: 1.25rem; font-weight: bold; "
-          "margin-bottom: 15px; color: #1a73e8; border-bottom: 2px solid "
-          "#e8f0fe; padding-bottom: 5px; }\n";
-  html += "        .input-grid { display: grid; grid-template-columns: "
-          "repeat(12, 1fr); gap: 5px; }\n";
-  html += "        .input-node { display: flex; flex-direction: column; "
-          "align-items: center; gap: 2px; }\n";
-  html += "        .id-label { font-size: 10px; color: #666; }\n";
-  html += "        .led { width: 18px; height: 18px; border-radius: 4px; "
-          "background: #e0e0e0; border: 1px solid #bdbdbd; cursor: pointer; "
-          "transition: all 0.2s; }\n";
-  html += "        .led:hover { transform: scale(1.2); }\n";
-  html += "        .led.active { background: #ff5252; border-color: #d32f2f; "
-          "box-shadow: 0 0 8px rgba(255,82,82,0.5); }\n";
-  html += "        .led.shielded { background: #fb8c00; border-color: #ef6c00; "
-          "position: relative; }\n";
-  html += "        .led.shielded::after { content: '×'; position: absolute; "
-          "color: white; font-size: 14px; top: 50%; left: 50%; transform: "
-          "translate(-50%, -50%); }\n";
-  html +=
-      "        .led.shielded.active { background: #ffa726; opacity: 0.7; }\n";
-  html += "        button { padding: 8px 16px; border: none; border-radius: "
-          "4px; background: #1a73e8; color: white; cursor: pointer; "
-          "transition: background 0.2s; }\n";
-  html += "        button:hover { background: #1557b0; }\n";
-  html += "        button.secondary { background: #6c757d; }\n";
-  html += "        button.danger { background: #dc3545; }\n";
-  html += "        input[type='number'] { padding: 6px; border: 1px solid "
-          "#ced4da; border-radius: 4px; width: 80px; }\n";
-  html += "        #config-banner { display: none; background: #fff3e0; color: "
-          "#e65100; padding: 10px; border-radius: 4px; text-align: center; "
-          "margin-bottom: 15px; font-weight: bold; }\n";
-  html += "    </style>\n";
-  html += "</head>\n";
-  html += "<body>\n";
-  html += "    <div class=\"container\">\n";
-  html += "        <div class=\"header\">\n";
-  html += "            <h1>Laser Sensor System</h1>\n";
-  html += "            <div id=\"conn-status\" style=\"color: red; "
-          "font-weight: bold;\">Disconnected</div>\n";
-  html += "        </div>\n";
-  html += "\n";
-  html += "        <div id=\"config-banner\">SHIELD CONFIGURATION MODE ACTIVE "
-          "- Click points to toggle mask</div>\n";
-  html += "\n";
-  html += "        <div class=\"status-bar\">\n";
-  html += "            <div>Last Update: <span "
-          "id=\"last-time\">--:--:--</span></div>\n";
-  html += "            <div>Active Clients: <span "
-          "id=\"client-count\">0</span></div>\n";
-  html += "        </div>\n";
-  html += "\n";
-  html += "        <div class=\"control-panel\">\n";
-  html += "            <label>Baseline Delay:</label>\n";
-  html +=
-      "            <input type=\"number\" id=\"delay-input\" value=\"200\">\n";
-  html += "            <button onclick=\"updateDelay()\">Set Delay</button>\n";
-  html += "            <label style=\"margin-left: 15px;\">Trigger Filter:</label>\n";
-  html += "            <input type=\"number\" id=\"filter-input\" value=\"20\" style=\"width: 60px;\">\n";
-  html += "            <button onclick=\"updateFilter()\">Set Filter</button>\n";
-  html += "            <button class=\"secondary\" onclick=\"toggleConfig()\" "
-          "id=\"config-btn\">Enter Shield Config</button>\n";
-  html += "            <button class=\"danger\" onclick=\"clearAllShielding()\">Clear All Shields</button>\n";
-  html += "            <div style=\"margin-left: auto;\">\n";
-  html += "                <input type=\"file\" id=\"ota-file\" "
-          "style=\"display:none\">\n";
-  html += "                <button class=\"danger\" "
-          "onclick=\"document.getElementById('ota-file').click()\">Select "
-          "Update</button>\n";
-  html += "                <button onclick=\"doOTA()\">Flash</button>\n";
-  html += "            </div>\n";
-  html += "        </div>\n";
-  html += "\n";
-  html += "        <div class=\"device-grid\" id=\"grid\"></div>\n";
-  html += "    </div>\n";
-  html += "\n";
-  html += "    <script>\n";
-  html += "        let configMode = false;\n";
-  html += "        let shieldMask = {};\n";
-  html += "        let eventSource = null;\n";
-  html += "\n";
-  html += "        function init() {\n";
-  html += "            fetch('/api/shield').then(r => r.json()).then(d => {\n";
-  html += "                shieldMask = d;\n";
-  html += "                applyShieldMask();\n";
-  html += "            });\n";
-  html += "            fetch('/api/baselineDelay').then(r => r.json()).then(d "
-          "=> document.getElementById('delay-input').value = d.delay);\n";
-  html += "            fetch('/api/triggerFilter').then(r => r.json()).then(d "
-          "=> document.getElementById('filter-input').value = d.threshold);\n";
-  html += "            setupSSE();\n";
-  html += "            renderEmpty();\n";
-  html += "        }\n";
-  html += "\n";
-  html += "        function applyShieldMask() {\n";
-  html += "            for(let d=1; d<=4; d++) {\n";
-  html += "                const key = 'device' + d;\n";
-  html += "                if(shieldMask[key]) {\n";
-  html += "                    shieldMask[key].forEach(inputId => {\n";
-  html += "                        const led = document.getElementById('l-' + d + '-' + inputId);\n";
-  html += "                        if(led) led.classList.add('shielded');\n";
-  html += "                    });\n";
-  html += "                }\n";
-  html += "            }\n";
-  html += "        }\n";
-  html += "\n";
-  html += "        function setupSSE() {\n";
-  html += "            if(eventSource) eventSource.close();\n";
-  html += "            eventSource = new EventSource('/events');\n";
-  html += "            eventSource.onopen = () => {\n";
-  html += "                document.getElementById('conn-status').textContent "
-          "= 'Connected';\n";
-  html += "                document.getElementById('conn-status').style.color "
-          "= 'green';\n";
-  html += "            };\n";
-  html += "            eventSource.onmessage = e => "
-          "updateDisplay(JSON.parse(e.data));\n";
-  html += "            eventSource.onerror = () => {\n";
-  html += "                document.getElementById('conn-status').textContent "
-          "= 'Disconnected';\n";
-  html += "                document.getElementById('conn-status').style.color "
-          "= 'red';\n";
-  html += "            };\n";
-  html += "        }\n";
-  html += "\n";
-  html += "        function renderEmpty() {\n";
-  html += "            const grid = document.getElementById('grid');\n";
-  html += "            grid.innerHTML = '';\n";
-  html += "            for(let d=1; d<=4; d++) {\n";
-  html += "                const card = document.createElement('div');\n";
-  html += "                card.className = 'device-card';\n";
-  html += "                card.innerHTML = `<div class='device-title'>Device "
-          "${d}</div><div class='input-grid' id='d-${d}'></div>`;\n";
-  html += "                grid.appendChild(card);\n";
-  html +=
-      "                const devGrid = card.querySelector('.input-grid');\n";
-  html += "                for(let i=1; i<=48; i++) {\n";
-  html += "                    devGrid.innerHTML += `<div "
-          "class='input-node'><div class='led' id='l-${d}-${i}' "
-          "onclick='handleLedClick(${d},${i})'></div><div "
-          "class='id-label'>${i}</div></div>`;\n";
-  html += "                }\n";
-  html += "            }\n";
-  html += "        }\n";
-  html += "\n";
-  html += "        function updateDisplay(data) {\n";
-  html += "            document.getElementById('last-time').textContent = new "
-          "Date().toLocaleTimeString();\n";
-  html += "            for(let d=1; d<=4; d++) {\n";
-  html += "                const inputs = data['device' + d];\n";
-  html += "                if(!inputs) continue;\n";
-  html += "                inputs.forEach(input => {\n";
-  html += "                    const led = "
-          "document.getElementById(`l-${d}-${input.id}`);\n";
-  html += "                    if(!led) return;\n";
-  html += "                    const isShielded = shieldMask['device'+d] && "
-          "shieldMask['device'+d].includes(input.id);\n";
-  html += "                    led.className = 'led' + (input.state ? ' "
-          "active' : '') + (isShielded ? ' shielded' : '');\n";
-  html += "                });\n";
-  html += "            }\n";
-  html += "        }\n";
-  html += "\n";
-  html += "        function handleLedClick(d, i) {\n";
-  html += "            if(!configMode) return;\n";
-  html += "            const key = 'device' + d;\n";
-  html += "            if(!shieldMask[key]) shieldMask[key] = [];\n";
-  html += "            const index = shieldMask[key].indexOf(i);\n";
-  html += "            const newState = index === -1;\n";
-  html += "            \n";
-  html += "            fetch('/api/shield', { method: 'POST', body: "
-          "JSON.stringify({ device: d, id: i, state: newState }) })\n";
-  html += "            .then(r => r.json()).then(res => {\n";
-  html += "                if(newState) shieldMask[key].push(i);\n";
-  html += "                else shieldMask[key].splice(index, 1);\n";
-  html +=
-      "                const led = document.getElementById(`l-${d}-${i}`);\n";
-  html += "                led.classList.toggle('shielded', newState);\n";
-  html += "            });\n";
-  html += "        }\n";
-  html += "\n";
-  html += "        function toggleConfig() {\n";
-  html += "            configMode = !configMode;\n";
-  html += "            document.getElementById('config-btn').textContent = "
-          "configMode ? 'Exit Shield Config' : 'Enter Shield Config';\n";
-  html += "            "
-          "document.getElementById('config-btn').classList.toggle('secondary', "
-          "!configMode);\n";
-  html += "            "
-          "document.getElementById('config-btn').classList.toggle('danger', "
-          "configMode);\n";
-  html += "            document.getElementById('config-banner').style.display "
-          "= configMode ? 'block' : 'none';\n";
-  html += "        }\n";
-  html += "\n";
-  html += "        function updateDelay() {\n";
-  html +=
-      "            const val = document.getElementById('delay-input').value;\n";
-  html += "            fetch('/api/baselineDelay', { method: 'POST', body: "
-          "JSON.stringify({ delay: parseInt(val) }) });\n";
-  html += "        }\n";
-  html += "\n";
-  html += "        function updateFilter() {\n";
-  html += "            const val = document.getElementById('filter-input').value;\n";
-  html += "            fetch('/api/triggerFilter', { method: 'POST', body: "
-          "JSON.stringify({ threshold: parseInt(val) }) })\n";
-  html += "            .then(r => r.json()).then(d => {\n";
-  html += "                alert('Trigger filter set to ' + d.threshold + ' points');\n";
-  html += "            });\n";
-  html += "        }\n";
-  html += "\n";
-  html += "        function clearAllShielding() {\n";
-  html += "            if(!confirm('Clear all shielding points?')) return;\n";
-  html += "            fetch('/api/clearShield', { method: 'POST' })\n";
-  html += "            .then(r => r.json()).then(res => {\n";
-  html += "                shieldMask = {};\n";
-  html += "                document.querySelectorAll('.led.shielded').forEach(led => {\n";
-  html += "                    led.classList.remove('shielded');\n";
-  html += "                });\n";
-  html += "                alert('All shielding cleared!');\n";
-  html += "            });\n";
-  html += "        }\n";
-  html += "\n";
-  html += "        function doOTA() {\n";
-  html += "            const file = "
-          "document.getElementById('ota-file').files[0];\n";
-  html += "            if(!file) return alert('Select file');\n";
-  html += "            const formData = new FormData();\n";
-  html += "            formData.append('update', file);\n";
-  html += "            fetch('/update', { method: 'POST', body: file }).then(r "
-          "=> {\n";
-  html += "                if(r.ok) alert('Update sent, rebooting...');\n";
-  html += "                else alert('Update failed');\n";
-  html += "            });\n";
-  html += "        }\n";
-  html += "\n";
-  html += "        init();\n";
-  html += "    </script>\n";
-  html += "</body>\n";
-  html += "</html>\n";
-  return html;
+    releaseSlot(slot);
+  }
 }
 
-void LaserWebServer::setBaselineDelay(unsigned long delay) {
-  baselineDelay = delay;
+// ============== 路由处理函数 ==============
+void LaserWebServer::handleIndex(ClientSlot &slot, HttpRequest &req) {
+  ResponseWriter(slot.client, req.keepAlive)
+      .sendBytes(200, "text/html", (const uint8_t *)INDEX_HTML,
+                 sizeof(INDEX_HTML) - 1);
 }
 
-unsigned long LaserWebServer::getBaselineDelay() { return baselineDelay; }
+void LaserWebServer::handleGetStates(ClientSlot &slot, HttpRequest &req) {
+  ResponseWriter(slot.client, req.keepAlive)
+      .sendGenerated("application/json",
+                     [this](Print &out) { writeDeviceStatesJSON(out, 0); });
+}
 
-String LaserWebServer::getBaselineDelayJSON() {
+void LaserWebServer::handleGetDeviceStates(ClientSlot &slot,
+                                           HttpRequest &req) {
+  int device = atoi(req.param(0));
+  if (device < 1 || device > 4) {
+    ResponseWriter(slot.client, false).sendError(404, "Not Found");
+    req.keepAlive = false;
+    return;
+  }
+  ResponseWriter(slot.client, req.keepAlive)
+      .sendGenerated("application/json", [this, device](Print &out) {
+        writeDeviceStatesJSON(out, device);
+      });
+}
+
+void LaserWebServer::handleGetShield(ClientSlot &slot, HttpRequest &req) {
+  sendCached(slot, req, CACHE_SHIELD_MASK);
+}
+
+void LaserWebServer::handlePostShield(ClientSlot &slot, HttpRequest &req) {
   DynamicJsonDocument doc(256);
-  doc["delay"] = baselineDelay;
+  if (deserializeJson(doc, req.body) == DeserializationError::Ok &&
+      doc.containsKey("device") && doc.containsKey("id") &&
+      doc.containsKey("state")) {
+    setShieldState(doc["device"], doc["id"], doc["state"]);
+    ResponseWriter(slot.client, req.keepAlive)
+        .send(200, "application/json", "{\"status\":\"ok\"}");
+  } else {
+    ResponseWriter(slot.client, false).sendError(400, "Bad Request");
+    req.keepAlive = false;
+  }
+}
+
+// 批量屏蔽：先完整校验并在副本上应用，全部合法才一次性提交
+// Body: {"masks": {"device1": [1,2,3], ...}, "changes": [{"device":1,"id":3,"state":true}, ...]}
+//   masks   - 整设备替换 (列出的设备以数组为准，未列出的设备不变)
+//   changes - 单点修改，在 masks 之后应用
+void LaserWebServer::handlePostShieldBatch(ClientSlot &slot,
+                                           HttpRequest &req) {
+  DynamicJsonDocument doc(SHIELD_BATCH_DOC_SIZE);
+  if (deserializeJson(doc, req.body) != DeserializationError::Ok) {
+    ResponseWriter(slot.client, false).sendError(400, "Bad Request");
+    req.keepAlive = false;
+    return;
+  }
+
+  uint8_t staged[4][48];
+  memcpy(staged, shieldMask, sizeof(staged));
+  bool valid = true;
+
+  JsonObject masks = doc["masks"];
+  if (!masks.isNull()) {
+    for (JsonPair kv : masks) {
+      int device = 0;
+      JsonArray inputs = kv.value().as<JsonArray>();
+      if (sscanf(kv.key().c_str(), "device%d", &device) != 1 || device < 1 ||
+          device > 4 || inputs.isNull()) {
+        valid = false;
+        break;
+      }
+      memset(staged[device - 1], 0, sizeof(staged[device - 1]));
+      for (JsonVariant v : inputs) {
+        int input = v | 0;
+        if (input < 1 || input > 48) {
+          valid = false;
+          break;
+        }
+        staged[device - 1][input - 1] = 1;
+      }
+    }
+  }
+
+  JsonArray changes = doc["changes"];
+  if (valid && !changes.isNull()) {
+    for (JsonObject change : changes) {
+      int device = change["device"] | 0;
+      int input = change["id"] | 0;
+      if (device < 1 || device > 4 || input < 1 || input > 48 ||
+          !change.containsKey("state")) {
+        valid = false;
+        break;
+      }
+      staged[device - 1][input - 1] = change["state"].as<bool>() ? 1 : 0;
+    }
+  }
+
+  if (!valid || (masks.isNull() && changes.isNull())) {
+    ResponseWriter(slot.client, false).sendError(400, "Bad Request");
+    req.keepAlive = false;
+    return;
+  }
+
+  int changed = applyShieldingBatch(staged);
+  StaticJsonDocument<64> result;
+  result["status"] = "ok";
+  result["changed"] = changed;
+  ResponseWriter(slot.client, req.keepAlive).sendJson(result);
+}
+
+void LaserWebServer::handleClearShield(ClientSlot &slot, HttpRequest &req) {
+  // 清空所有屏蔽点
+  clearShielding();
+  ResponseWriter(slot.client, req.keepAlive)
+      .send(200, "application/json",
+            "{\"status\":\"ok\",\"message\":\"All shielding cleared\"}");
+}
+
+void LaserWebServer::handleGetBaselineDelay(ClientSlot &slot,
+                                            HttpRequest &req) {
+  sendCached(slot, req, CACHE_BASELINE_DELAY);
+}
 
-  String output;
-  serializeJson(doc, output);
-  return output;
+void LaserWebServer::handlePostBaselineDelay(ClientSlot &slot,
+                                             HttpRequest &req) {
+  DynamicJsonDocument doc(256);
+  if (deserializeJson(doc, req.body) != DeserializationError::Ok ||
+      !doc["delay"].is<int>() || doc["delay"].as<long>() < 0 ||
+      doc["delay"].as<long>() > 65535) {
+    ResponseWriter(slot.client, false).sendError(400, "Bad Request");
+    req.keepAlive = false;
+    return;
+  }
+
+  // 经 DetectionConfig 排队，主循环在扫描边界生效并保存
+  DetectionConfig config = detectionConfig.latest();
+  config.baselineDelayMs = doc["delay"].as<int>();
+  const char *error = detectionConfig.stage(config);
+  if (error) {
+    ResponseWriter(slot.client, false).sendError(400, error);
+    req.keepAlive = false;
+    return;
+  }
+  setBaselineDelay(config.baselineDelayMs);
+  sendCached(slot, req, CACHE_BASELINE_DELAY);
+}
+
+void LaserWebServer::handleGetConfig(ClientSlot &slot, HttpRequest &req) {
+  ResponseWriter(slot.client, req.keepAlive)
+      .sendGenerated("application/json", [](Print &out) {
+        writeDetectionConfigJSON(out, detectionConfig.latest(),
+                                 detectionConfig.hasPending());
+      });
+}
+
+// 部分更新：只需包含要修改的字段，校验失败返回 400 和原因
+void LaserWebServer::handlePostConfig(ClientSlot &slot, HttpRequest &req) {
+  DetectionConfig config = detectionConfig.latest();
+  const char *error =
+      mergeDetectionConfigJSON(req.body.c_str(), req.body.length(), config);
+  if (error == nullptr)
+    error = detectionConfig.stage(config);
+  if (error) {
+    ResponseWriter(slot.client, false).sendError(400, error);
+    req.keepAlive = false;
+    return;
+  }
+  ResponseWriter(slot.client, req.keepAlive)
+      .sendGenerated("application/json", [](Print &out) {
+        out.printf("{\"status\":\"ok\",\"revision\":%lu}",
+                   (unsigned long)detectionConfig.latest().revision);
+      });
+}
+
+// 写回日志中的修改在主循环下一轮立即写入 Flash，不必等静默期
+void LaserWebServer::handlePostConfigSave(ClientSlot &slot, HttpRequest &req) {
+  configJournal.requestFlush();
+  ResponseWriter(slot.client, req.keepAlive)
+      .send(200, "application/json",
+            configJournal.getDirty() ? "{\"status\":\"ok\",\"pending\":true}"
+                                     : "{\"status\":\"ok\",\"pending\":false}");
+}
+
+void LaserWebServer::handleGetProfiles(ClientSlot &slot, HttpRequest &req) {
+  ResponseWriter(slot.client, req.keepAlive)
+      .sendGenerated("application/json",
+                     [](Print &out) { profiles.writeJSON(out); });
+}
+
+// {"name":"A"}：把当前屏蔽、分区、检测参数和过滤阈值保存为方案 (同名覆盖)
+void LaserWebServer::handlePostProfiles(ClientSlot &slot, HttpRequest &req) {
+  runProfileAction(slot, req, PROFILE_SAVE);
+}
+
+void LaserWebServer::handlePostProfileActivate(ClientSlot &slot,
+                                               HttpRequest &req) {
+  runProfileAction(slot, req, PROFILE_ACTIVATE);
+}
+
+void LaserWebServer::handlePostProfileDelete(ClientSlot &slot,
+                                             HttpRequest &req) {
+  runProfileAction(slot, req, PROFILE_DELETE);
+}
+
+void LaserWebServer::runProfileAction(ClientSlot &slot, HttpRequest &req,
+                                      ProfileAction action) {
+  StaticJsonDocument<128> doc;
+  const char *name = nullptr;
+  if (deserializeJson(doc, req.body) == DeserializationError::Ok)
+    name = doc["name"];
+  if (name == nullptr || !validProfileName(name)) {
+    ResponseWriter(slot.client, false).sendError(400, "Bad Request");
+    req.keepAlive = false;
+    return;
+  }
+
+  if (profileCallback == nullptr || !profileCallback(action, name)) {
+    // 保存失败只可能是方案已满，其余为名称不存在
+    ResponseWriter(slot.client, false)
+        .sendError(action == PROFILE_SAVE ? 409 : 404,
+                   action == PROFILE_SAVE ? "Profile table full"
+                                          : "Profile not found");
+    req.keepAlive = false;
+    return;
+  }
+  ResponseWriter(slot.client, req.keepAlive)
+      .sendGenerated("application/json",
+                     [](Print &out) { profiles.writeJSON(out); });
+}
+
+void LaserWebServer::handleGetTriggerFilter(ClientSlot &slot,
+                                            HttpRequest &req) {
+  sendCached(slot, req, CACHE_TRIGGER_FILTER);
+}
+
+void LaserWebServer::handlePostTriggerFilter(ClientSlot &slot,
+                                             HttpRequest &req) {
+  DynamicJsonDocument doc(256);
+  if (deserializeJson(doc, req.body) == DeserializationError::Ok) {
+    int threshold = doc["threshold"];
+    setTriggerFilterThreshold(threshold);
+    if (triggerFilterCallback != nullptr) {
+      triggerFilterCallback(threshold);
+    }
+    sendCached(slot, req, CACHE_TRIGGER_FILTER);
+  } else {
+    ResponseWriter(slot.client, false).sendError(400, "Bad Request");
+    req.keepAlive = false;
+  }
+}
+
+void LaserWebServer::handleGetZones(ClientSlot &slot, HttpRequest &req) {
+  ResponseWriter(slot.client, req.keepAlive)
+      .sendGenerated("application/json",
+                     [this](Print &out) { writeZonesJSON(out); });
+}
+
+void LaserWebServer::writeZonesJSON(Print &out) {
+  out.printf("{\"maxZones\":%d,\"zones\":[", MAX_ZONES);
+  for (int z = 0; z < zoneCount; z++) {
+    const Zone &zone = zones[z];
+    out.printf("%s{\"name\":\"%s\",\"enabled\":%s,\"topic\":\"%s\",\"beams\":\"",
+               z ? "," : "", zone.name, zone.enabled ? "true" : "false",
+               zone.topic);
+    printBeamRanges(out, zone.mask);
+    out.printf("\",\"tolerance\":%u,\"windowMs\":%u,\"debounceMs\":%u,"
+               "\"filter\":%u}",
+               zone.tolerance, zone.windowMs, zone.debounceMs,
+               zone.filterCeiling);
+  }
+  out.print("]}");
+}
+
+// 名称和主题原样写入 JSON 与 MQTT 负载，只允许可打印且无需转义的字符
+static bool copyZoneText(char *dst, size_t size, const char *src) {
+  size_t len = strlen(src);
+  if (len == 0 || len >= size)
+    return false;
+  for (size_t i = 0; i < len; i++) {
+    if ((unsigned char)src[i] < 0x20 || src[i] == '"' || src[i] == '\\')
+      return false;
+  }
+  memcpy(dst, src, len + 1);
+  return true;
 }
 
+// 整表替换：{"zones":[{"name","beams":"1-20,49",...}]}，任一分区非法则全部不生效
+void LaserWebServer::handlePostZones(ClientSlot &slot, HttpRequest &req) {
+  DynamicJsonDocument doc(6144);
+  JsonArray list;
+  if (deserializeJson(doc, req.body) == DeserializationError::Ok)
+    list = doc["zones"];
+
+  Zone staged[MAX_ZONES];
+  bool valid = !list.isNull() && list.size() <= MAX_ZONES;
+  bool windowTooLong = false;
+  uint8_t count = 0;
+  if (valid) {
+    for (JsonObject item : list) {
+      Zone &zone = staged[count];
+      memset(&zone, 0, sizeof(zone));
+      char fallback[ZONE_TOPIC_LEN];
+      snprintf(fallback, sizeof(fallback), "zone%d", count + 1);
+      const char *name = item["name"] | (const char *)fallback;
+      valid = copyZoneText(zone.name, sizeof(zone.name), name);
+      snprintf(fallback, sizeof(fallback), "receiver/zone/%s", zone.name);
+      const char *topic = item["topic"] | (const char *)fallback;
+      valid = valid && copyZoneText(zone.topic, sizeof(zone.topic), topic) &&
+              parseBeamRanges(item["beams"] | "", zone.mask);
+
+      int tolerance = item["tolerance"] | 1;
+      int windowMs = item["windowMs"] | 90;
+      int debounceMs = item["debounceMs"] | 60;
+      int filter = item["filter"] | 0;
+      // 分区按同一份去抖历史重新统计，窗口同样受 DEBOUNCE_MAX_HISTORY 限制
+      windowTooLong = windowMs > DEBOUNCE_MAX_WINDOW_MS;
+      valid = valid && tolerance >= 1 && tolerance <= ZONE_TOTAL_BEAMS &&
+              debounceMs >= 0 && windowMs >= debounceMs && !windowTooLong &&
+              filter >= 0 && filter <= ZONE_TOTAL_BEAMS;
+      if (!valid)
+        break;
+      zone.enabled = item["enabled"] | true;
+      zone.tolerance = tolerance;
+      zone.windowMs = windowMs;
+      zone.debounceMs = debounceMs;
+      zone.filterCeiling = filter;
+      count++;
+    }
+  }
+
+  if (!valid) {
+    char error[64];
+    snprintf(error, sizeof(error), "windowMs must be <= %u ms (%u scans)",
+             (unsigned)DEBOUNCE_MAX_WINDOW_MS, (unsigned)DEBOUNCE_MAX_HISTORY);
+    ResponseWriter(slot.client, false)
+        .sendError(400, windowTooLong ? error : "Bad Request");
+    req.keepAlive = false;
+    return;
+  }
+
+  setZones(staged, count);
+  if (zonesCallback != nullptr)
+    zonesCallback(zones, zoneCount);
+  StaticJsonDocument<64> result;
+  result["status"] = "ok";
+  result["count"] = count;
+  ResponseWriter(slot.client, req.keepAlive).sendJson(result);
+}
+
+// OTA 在后台任务中进行，扫描循环不受影响；进度通过 SSE "ota" 事件推送。
+// 期望的 SHA-256 通过 X-Firmware-SHA256 请求头或 ?sha256= 提供。
+void LaserWebServer::handleUpdate(ClientSlot &slot, HttpRequest &req) {
+  req.keepAlive = false;
+  char sha256[65];
+  strlcpy(sha256, req.firmwareSha256, sizeof(sha256));
+  if (sha256[0] == '\0')
+    req.queryParam("sha256", sha256, sizeof(sha256));
+
+  if (!ota.start(slot.client, req.contentLength, sha256)) {
+    Serial.printf("OTA rejected: %s\n", ota.getError());
+    int code = ota.isBusy() ? 409 : 400;
+    ResponseWriter(slot.client, false).sendError(code, ota.getError());
+    return;
+  }
+
+  // socket 已由 OTA 任务接管，完成后由任务回复并关闭
+  detachSlot(slot);
+}
+
+void LaserWebServer::handleEvents(ClientSlot &slot, HttpRequest &req) {
+  // 流式客户端单独限额，超出时拒绝而不是挤占 REST 连接
+  if (countSlots(true) >= WEB_MAX_SSE_CLIENTS) {
+    ResponseWriter(slot.client, false).sendError(503, "Too many event streams");
+    req.keepAlive = false;
+    return;
+  }
+  static const char header[] = "HTTP/1.1 200 OK\r\n"
+                               "Content-Type: text/event-stream\r\n"
+                               "Cache-Control: no-cache\r\n"
+                               "Connection: keep-alive\r\n"
+                               "Access-Control-Allow-Origin: *\r\n\r\n";
+  slot.client.write((const uint8_t *)header, sizeof(header) - 1);
+  slot.client.flush();
+  slot.isSSE = true;
+}
+
+// Prometheus 抓取：先刷新堆/栈水位，再两遍生成 (计数 + 输出)，不分配堆内存
+void LaserWebServer::handleMetrics(ClientSlot &slot, HttpRequest &req) {
+  metrics.heapFree.set(ESP.getFreeHeap());
+  metrics.heapMin.set(ESP.getMinFreeHeap());
+  metrics.loopStackHighWater.set(uxTaskGetStackHighWaterMark(NULL));
+  metrics.otaStackHighWater.set(ota.getStackHighWaterMark());
+  ResponseWriter(slot.client, req.keepAlive)
+      .sendGenerated("text/plain; version=0.0.4",
+                     [](Print &out) { metrics.writePrometheus(out); });
+}
+
+// 扫描各阶段耗时分布 (微秒)，device 0 为整轮扫描级别的阶段
+void LaserWebServer::handleGetPerf(ClientSlot &slot, HttpRequest &req) {
+  ResponseWriter(slot.client, req.keepAlive)
+      .sendGenerated("application/json",
+                     [](Print &out) { perf.writeJSON(out); });
+}
+
+// 原始样本 CSV 导出 (需先通过 reset?raw=1 开启采集)
+void LaserWebServer::handleGetPerfRaw(ClientSlot &slot, HttpRequest &req) {
+  ResponseWriter(slot.client, req.keepAlive)
+      .sendGenerated("text/csv",
+                     [](Print &out) { perf.writeRawCSV(out); });
+}
+
+// 清空直方图与原始样本；?raw=1/0 同时开启/关闭原始样本采集
+void LaserWebServer::handlePostPerfReset(ClientSlot &slot, HttpRequest &req) {
+  char raw[4];
+  if (req.queryParam("raw", raw, sizeof(raw)))
+    perf.setRawCapture(raw[0] == '1');
+  perf.reset();
+  ResponseWriter(slot.client, req.keepAlive)
+      .send(200, "application/json",
+            perf.getRawCapture() ? "{\"status\":\"ok\",\"rawCapture\":true}"
+                                 : "{\"status\":\"ok\",\"rawCapture\":false}");
+}
+
+void LaserWebServer::handleGetAvailability(ClientSlot &slot,
+                                           HttpRequest &req) {
+  ResponseWriter(slot.client, req.keepAlive)
+      .sendGenerated("application/json",
+                     [](Print &out) { availability.writeJSON(out); });
+}
+
+void LaserWebServer::handleGetBeamStats(ClientSlot &slot, HttpRequest &req) {
+  unsigned long now = millis();
+  ResponseWriter(slot.client, req.keepAlive)
+      .sendGenerated("application/json",
+                     [now](Print &out) { beamStats.writeJSON(out, now); });
+}
+
+void LaserWebServer::handlePostBeamStatsReset(ClientSlot &slot,
+                                              HttpRequest &req) {
+  beamStats.reset(millis());
+  ResponseWriter(slot.client, req.keepAlive)
+      .send(200, "application/json", "{\"status\":\"ok\"}");
+}
+
+// 屏蔽闪烁率超过 {"threshold":X} 次/分钟的全部光束，经批量接口只写一次 Flash
+void LaserWebServer::handlePostBeamStatsShield(ClientSlot &slot,
+                                               HttpRequest &req) {
+  DynamicJsonDocument doc(256);
+  if (deserializeJson(doc, req.body) != DeserializationError::Ok ||
+      !doc["threshold"].is<int>() || doc["threshold"].as<int>() < 0) {
+    ResponseWriter(slot.client, false).sendError(400, "Bad Request");
+    req.keepAlive = false;
+    return;
+  }
+
+  uint64_t noisy[4];
+  beamStats.aboveThreshold(doc["threshold"].as<int>(), millis(), noisy);
+  uint8_t staged[4][48];
+  memcpy(staged, shieldMask, sizeof(staged));
+  for (int d = 0; d < 4; d++)
+    for (uint64_t m = noisy[d]; m; m &= m - 1)
+      staged[d][__builtin_ctzll(m)] = 1;
+
+  int changed = applyShieldingBatch(staged);
+  StaticJsonDocument<64> result;
+  result["status"] = "ok";
+  result["changed"] = changed;
+  ResponseWriter(slot.client, req.keepAlive).sendJson(result);
+}
+
+void LaserWebServer::handleGetCalibration(ClientSlot &slot, HttpRequest &req) {
+  unsigned long now = millis();
+  ResponseWriter(slot.client, req.keepAlive)
+      .sendGenerated("application/json",
+                     [now](Print &out) { calibrator.writeJSON(out, now); });
+}
+
+// {"minutes":N} 开始校准，N 为 0 取消；未处于监测状态时返回 409
+void LaserWebServer::handlePostCalibration(ClientSlot &slot, HttpRequest &req) {
+  DynamicJsonDocument doc(256);
+  if (deserializeJson(doc, req.body) != DeserializationError::Ok ||
+      !doc["minutes"].is<int>() || doc["minutes"].as<int>() < 0 ||
+      doc["minutes"].as<int>() > CAL_MAX_MINUTES) {
+    ResponseWriter(slot.client, false).sendError(400, "Bad Request");
+    req.keepAlive = false;
+    return;
+  }
+
+  if (calibrationCallback == nullptr ||
+      !calibrationCallback(doc["minutes"].as<int>())) {
+    ResponseWriter(slot.client, false)
+        .sendError(409, "Calibration requires an active baseline");
+    req.keepAlive = false;
+    return;
+  }
+  ResponseWriter(slot.client, req.keepAlive)
+      .send(200, "application/json", "{\"status\":\"ok\"}");
+}
+
+// Chrome trace_event 导出；?clear=1 导出后清空缓冲区
+void LaserWebServer::handleGetTrace(ClientSlot &slot, HttpRequest &req) {
+#if TRACE_ENABLED
+  ResponseWriter(slot.client, req.keepAlive)
+      .sendGenerated("application/json",
+                     [](Print &out) { tracer.writeChromeJSON(out); });
+  char clear[4];
+  if (req.queryParam("clear", clear, sizeof(clear)) && clear[0] == '1')
+    tracer.clear();
+#else
+  ResponseWriter(slot.client, false)
+      .sendError(501, "Tracing disabled (build with -DTRACE_ENABLED=1)");
+  req.keepAlive = false;
+#endif
+}
+
+void LaserWebServer::setBaselineDelay(unsigned long delay) {
+  baselineDelay = delay;
+  invalidateResponseCache();
+}
+
+unsigned long LaserWebServer::getBaselineDelay() { return baselineDelay; }
+
 void LaserWebServer::setShieldState(uint8_t deviceAddr, uint8_t inputNum,
                                     bool state) {
   if (deviceAddr >= 1 && deviceAddr <= 4 && inputNum >= 1 && inputNum <= 48) {
     uint8_t oldState = shieldMask[deviceAddr - 1][inputNum - 1];
     shieldMask[deviceAddr - 1][inputNum - 1] = state ? 1 : 0;
+    if (oldState != (state ? 1 : 0))
+      invalidateResponseCache();
 
     // Trigger callback only if state actually changed
     if (oldState != (state ? 1 : 0) && shieldingChangeCallback != nullptr) {
@@ -629,27 +1783,26 @@ bool LaserWebServer::getShieldState(uint8_t deviceAddr, uint8_t inputNum) {
   return false;
 }
 
-String LaserWebServer::getShieldMaskJSON() {
-  DynamicJsonDocument doc(4096);
-
+// {"device1":[3,17],"device2":[],...}
+void LaserWebServer::writeShieldMaskJSON(Print &out) {
+  out.print('{');
   for (int device = 1; device <= 4; device++) {
-    String deviceKey = "device" + String(device);
-    JsonArray inputs = doc.createNestedArray(deviceKey);
-
+    out.printf("%s\"device%d\":[", device > 1 ? "," : "", device);
+    bool first = true;
     for (int input = 1; input <= 48; input++) {
       if (shieldMask[device - 1][input - 1] == 1) {
-        inputs.add(input);
+        out.printf(first ? "%d" : ",%d", input);
+        first = false;
       }
     }
+    out.print(']');
   }
-
-  String output;
-  serializeJson(doc, output);
-  return output;
+  out.print('}');
 }
 
 void LaserWebServer::loadShielding(uint8_t shielding[4][48]) {
   memcpy(shieldMask, shielding, sizeof(shieldMask));
+  invalidateResponseCache();
 }
 
 void LaserWebServer::setShieldingChangeCallback(
@@ -661,6 +1814,7 @@ void LaserWebServer::setShieldingChangeCallback(
 void LaserWebServer::clearShielding() {
   // 清空所有屏蔽点
   memset(shieldMask, 0, sizeof(shieldMask));
+  invalidateResponseCache();
   Serial.println("All shielding points cleared");
   
   // 触发回调通知 main.cpp
@@ -669,22 +1823,40 @@ void LaserWebServer::clearShielding() {
   }
 }
 
-void LaserWebServer::setClearShieldingCallback(ClearShieldingCallback callback) {
-  clearShieldingCallback = callback;
-  Serial.println("Clear shielding callback registered");
+// 一次性替换整张屏蔽表，只有实际发生变化时才触发一次批量回调
+int LaserWebServer::applyShieldingBatch(uint8_t shielding[4][48]) {
+  int changed = 0;
+  for (int d = 0; d < 4; d++) {
+    for (int i = 0; i < 48; i++) {
+      if (shieldMask[d][i] != shielding[d][i])
+        changed++;
+    }
+  }
+  if (changed == 0)
+    return 0;
+
+  memcpy(shieldMask, shielding, sizeof(shieldMask));
+  invalidateResponseCache();
+  if (shieldingBatchCallback != nullptr) {
+    shieldingBatchCallback(shieldMask, changed);
+  }
+  return changed;
 }
 
-String LaserWebServer::getTriggerFilterJSON() {
-  DynamicJsonDocument doc(256);
-  doc["threshold"] = triggerFilterThreshold;
+void LaserWebServer::setShieldingBatchCallback(
+    ShieldingBatchCallback callback) {
+  shieldingBatchCallback = callback;
+  Serial.println("Shielding batch callback registered");
+}
 
-  String output;
-  serializeJson(doc, output);
-  return output;
+void LaserWebServer::setClearShieldingCallback(ClearShieldingCallback callback) {
+  clearShieldingCallback = callback;
+  Serial.println("Clear shielding callback registered");
 }
 
 void LaserWebServer::setTriggerFilterThreshold(int threshold) {
   triggerFilterThreshold = threshold;
+  invalidateResponseCache();
 }
 
 int LaserWebServer::getTriggerFilterThreshold() {
@@ -694,4 +1866,26 @@ int LaserWebServer::getTriggerFilterThreshold() {
 void LaserWebServer::setTriggerFilterCallback(TriggerFilterCallback callback) {
   triggerFilterCallback = callback;
   Serial.println("Trigger filter callback registered");
-}
\ No newline at end of file
+}
+
+void LaserWebServer::setZones(const Zone *newZones, uint8_t count) {
+  if (count > MAX_ZONES)
+    count = MAX_ZONES;
+  memcpy(zones, newZones, sizeof(Zone) * count);
+  zoneCount = count;
+}
+
+void LaserWebServer::setZonesCallback(ZonesChangeCallback callback) {
+  zonesCallback = callback;
+  Serial.println("Zones callback registered");
+}
+
+void LaserWebServer::setCalibrationCallback(CalibrationCallback callback) {
+  calibrationCallback = callback;
+  Serial.println("Calibration callback registered");
+}
+
+void LaserWebServer::setProfileCallback(ProfileCallback callback) {
+  profileCallback = callback;
+  Serial.println("Profile callback registered");
+}
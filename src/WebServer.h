@@ -4,17 +4,150 @@
 #include <Arduino.h>
 #include <ArduinoJson.h>
 #include <WiFi.h>
+#include "OtaUpdater.h"
+#include "Profiles.h"
+#include "Zones.h"
 
 typedef void (*ShieldingChangeCallback)(uint8_t deviceAddr, uint8_t inputNum, bool state);
 typedef void (*ClearShieldingCallback)();
+typedef void (*ShieldingBatchCallback)(uint8_t shielding[4][48], int changed);
 typedef void (*TriggerFilterCallback)(int threshold);
+typedef void (*ZonesChangeCallback)(const Zone *zones, uint8_t count);
+typedef bool (*CalibrationCallback)(uint16_t minutes); // 0 = 取消
+typedef bool (*ProfileCallback)(ProfileAction action, const char *name);
+
+// ============== 连接池配置 (可在 platformio.ini build_flags 中覆盖) ==============
+#ifndef WEB_MAX_CLIENTS
+#define WEB_MAX_CLIENTS 8              // 连接池总槽位数
+#endif
+#ifndef WEB_MAX_SSE_CLIENTS
+#define WEB_MAX_SSE_CLIENTS 4          // 流式 (SSE) 客户端上限
+#endif
+#ifndef WEB_MAX_HTTP_CLIENTS
+#define WEB_MAX_HTTP_CLIENTS 6         // 请求/响应 (REST) 客户端上限
+#endif
+#ifndef WEB_KEEPALIVE_TIMEOUT_MS
+#define WEB_KEEPALIVE_TIMEOUT_MS 5000  // keep-alive 空闲超时
+#endif
+#ifndef WEB_KEEPALIVE_MAX_REQUESTS
+#define WEB_KEEPALIVE_MAX_REQUESTS 100 // 单连接最多复用的请求数
+#endif
+#ifndef WEB_REQUEST_TIMEOUT_MS
+#define WEB_REQUEST_TIMEOUT_MS 1000    // 请求头/请求体须在该时间内到齐 (增量读取，不阻塞主循环)
+#endif
+#ifndef WEB_MAX_BODY_SIZE
+#define WEB_MAX_BODY_SIZE 4096         // REST 请求体上限 (OTA 除外)
+#endif
+// /api/shield/batch 的解析缓冲：{"device":d,"id":i,"state":true} 每条约 35 字节，
+// 解析后占一个 3 成员对象 + 数组槽 (约 64 字节)，按请求体上限的 2 倍预留
+#define SHIELD_BATCH_DOC_SIZE (WEB_MAX_BODY_SIZE * 2)
+
+#ifndef WEB_CACHE_RESPONSE_SIZE
+#define WEB_CACHE_RESPONSE_SIZE 1280   // 单条缓存响应 (头 + 体) 上限
+#endif
+
+// ============== HTTP 请求解析结果 ==============
+#define HTTP_MAX_PATH_LEN 64
+#define HTTP_MAX_QUERY_LEN 96
+#define HTTP_MAX_PATH_PARAMS 2
+#define HTTP_MAX_PARAM_LEN 16
+
+enum HttpMethod : uint8_t {
+  METHOD_GET,
+  METHOD_POST,
+  METHOD_OPTIONS,
+  METHOD_UNKNOWN
+};
+
+// 请求行只解析一次：方法 + 路径 + 查询串，路径参数由路由表填充
+struct HttpRequest {
+  HttpMethod method;
+  char path[HTTP_MAX_PATH_LEN];
+  char query[HTTP_MAX_QUERY_LEN];
+  size_t contentLength;
+  bool keepAlive;
+  char firmwareSha256[65]; // X-Firmware-SHA256 请求头
+  char ifNoneMatch[24];    // If-None-Match 请求头
+  String body;
+  uint8_t paramCount;
+  char params[HTTP_MAX_PATH_PARAMS][HTTP_MAX_PARAM_LEN];
+
+  const char *param(uint8_t index) const {
+    return index < paramCount ? params[index] : "";
+  }
+  bool queryParam(const char *name, char *out, size_t outLen) const;
+};
+
+// 请求的增量读取阶段：每次 handleClient() 只消费已到达的数据，
+// 半个请求留在槽位中等下一轮，慢速或不完整的客户端不会阻塞扫描
+enum RequestPhase : uint8_t {
+  REQ_IDLE,    // 等待新请求
+  REQ_LINE,    // 读取请求行
+  REQ_HEADERS, // 读取请求头
+  REQ_BODY     // 按 Content-Length 读取请求体
+};
+
+#define HTTP_MAX_LINE_LEN (HTTP_MAX_PATH_LEN + HTTP_MAX_QUERY_LEN + 32)
+
+// 连接池中的一个客户端槽位
+struct ClientSlot {
+  WiFiClient client;
+  bool isSSE;                  // 已升级为 /events 流
+  bool keepAlive;              // 响应后保持连接
+  unsigned long lastActivity;  // 最近一次收发时间，用于空闲超时
+  uint16_t requestCount;       // 该连接已处理的请求数
+
+  // 跨多次 handleClient() 的请求解析状态
+  RequestPhase phase;
+  unsigned long requestStart;  // 请求首字节到达时间
+  uint8_t lineLen;             // line 中已读入的字节数
+  int8_t connectionHeader;     // 0: 未指定, 1: close, 2: keep-alive
+  bool isHTTP10;
+  int16_t route;               // 请求头读完后匹配到的路由下标
+  char line[HTTP_MAX_LINE_LEN];
+  HttpRequest req;
+};
+
+// 预渲染的配置类 GET 响应 (仅在配置变更后重新渲染)
+enum ResponseCacheId : uint8_t {
+  CACHE_SHIELD_MASK,
+  CACHE_BASELINE_DELAY,
+  CACHE_TRIGGER_FILTER,
+  CACHE_COUNT
+};
+
+struct CachedResponse {
+  char data[WEB_CACHE_RESPONSE_SIZE]; // 完整 HTTP 响应
+  size_t length;                      // 0 表示未渲染或超出缓冲
+  uint32_t version;                   // 渲染时的 configVersion
+  bool keepAlive;                     // 渲染时的 Connection 头
+  char etag[24];
+};
 
 class LaserWebServer {
 private:
+  // 路由处理函数与静态路由表 (按 pattern、method 排序，二分查找)
+  typedef void (LaserWebServer::*RouteHandler)(ClientSlot &slot,
+                                               HttpRequest &req);
+  struct Route {
+    HttpMethod method;
+    const char *pattern; // 以 ':' 开头的路径段为参数，如 /api/states/:device
+    RouteHandler handler;
+    bool streamBody;     // true: 不预读请求体，由处理函数自行读取 (OTA)
+  };
+  static const Route routes[];
+  static const size_t routeCount;
+  static constexpr bool routesSortedFrom(size_t i);
+
   WiFiServer server;
-  WiFiClient clients[4];
-  bool isSSEClient[4];
+  ClientSlot slots[WEB_MAX_CLIENTS];
   int clientCount;
+  OtaUpdater ota;
+  uint32_t bootId;         // 每次启动随机，避免重启后 ETag 与旧缓存碰撞
+  uint32_t configVersion;  // 任何配置 setter 都会递增，使响应缓存失效
+  CachedResponse responseCache[CACHE_COUNT];
+  int lastOtaPercent;
+  OtaState lastOtaState;
   bool isWebServerRunning;
   unsigned long lastUpdateTime;
   unsigned long baselineDelay;
@@ -22,19 +155,77 @@ private:
   
   uint8_t deviceStates[4][48];
   uint8_t shieldMask[4][48];
+  Zone zones[MAX_ZONES];
+  uint8_t zoneCount;
   
   ShieldingChangeCallback shieldingChangeCallback;
   ClearShieldingCallback clearShieldingCallback;
+  ShieldingBatchCallback shieldingBatchCallback;
   TriggerFilterCallback triggerFilterCallback;
+  ZonesChangeCallback zonesCallback;
+  CalibrationCallback calibrationCallback;
+  ProfileCallback profileCallback;
   
-  String getHTTPResponse(const String &contentType, const String &content);
-  void handleHTTPRequest(WiFiClient &client, int slotIndex);
+  void sendCached(ClientSlot &slot, HttpRequest &req, ResponseCacheId id);
+  void writeCachedBody(Print &out, ResponseCacheId id);
+  void invalidateResponseCache();
+  void handleHTTPRequest(ClientSlot &slot);
+  void startRequest(ClientSlot &slot);
+  bool parseRequestLine(ClientSlot &slot);
+  void parseHeaderLine(ClientSlot &slot);
+  bool routeRequest(ClientSlot &slot);
+  void dispatchRequest(ClientSlot &slot);
+  void finishRequest(ClientSlot &slot);
+  const Route *findRoute(HttpRequest &req, bool &pathMatched);
+  bool matchPattern(const char *pattern, const char *path, HttpRequest &req);
+
+  void handleIndex(ClientSlot &slot, HttpRequest &req);
+  void handleGetStates(ClientSlot &slot, HttpRequest &req);
+  void handleGetDeviceStates(ClientSlot &slot, HttpRequest &req);
+  void handleGetShield(ClientSlot &slot, HttpRequest &req);
+  void handlePostShield(ClientSlot &slot, HttpRequest &req);
+  void handlePostShieldBatch(ClientSlot &slot, HttpRequest &req);
+  void handleClearShield(ClientSlot &slot, HttpRequest &req);
+  void handleGetAvailability(ClientSlot &slot, HttpRequest &req);
+  void handleGetBaselineDelay(ClientSlot &slot, HttpRequest &req);
+  void handlePostBaselineDelay(ClientSlot &slot, HttpRequest &req);
+  void handleGetConfig(ClientSlot &slot, HttpRequest &req);
+  void handlePostConfig(ClientSlot &slot, HttpRequest &req);
+  void handlePostConfigSave(ClientSlot &slot, HttpRequest &req);
+  void handleGetProfiles(ClientSlot &slot, HttpRequest &req);
+  void handlePostProfiles(ClientSlot &slot, HttpRequest &req);
+  void handlePostProfileActivate(ClientSlot &slot, HttpRequest &req);
+  void handlePostProfileDelete(ClientSlot &slot, HttpRequest &req);
+  void runProfileAction(ClientSlot &slot, HttpRequest &req,
+                        ProfileAction action);
+  void handleGetTriggerFilter(ClientSlot &slot, HttpRequest &req);
+  void handlePostTriggerFilter(ClientSlot &slot, HttpRequest &req);
+  void handleGetZones(ClientSlot &slot, HttpRequest &req);
+  void handlePostZones(ClientSlot &slot, HttpRequest &req);
+  void handleUpdate(ClientSlot &slot, HttpRequest &req);
+  void handleEvents(ClientSlot &slot, HttpRequest &req);
+  void handleMetrics(ClientSlot &slot, HttpRequest &req);
+  void handleGetPerf(ClientSlot &slot, HttpRequest &req);
+  void handleGetPerfRaw(ClientSlot &slot, HttpRequest &req);
+  void handlePostPerfReset(ClientSlot &slot, HttpRequest &req);
+  void handleGetTrace(ClientSlot &slot, HttpRequest &req);
+  void handleGetBeamStats(ClientSlot &slot, HttpRequest &req);
+  void handlePostBeamStatsReset(ClientSlot &slot, HttpRequest &req);
+  void handlePostBeamStatsShield(ClientSlot &slot, HttpRequest &req);
+  void handleGetCalibration(ClientSlot &slot, HttpRequest &req);
+  void handlePostCalibration(ClientSlot &slot, HttpRequest &req);
+  void acceptNewClient();
+  void releaseSlot(ClientSlot &slot);
+  void detachSlot(ClientSlot &slot);
+  void broadcastEvent(const char *event, const char *data);
+  void broadcastOtaProgress();
+  int countSlots(bool sse);
+  int findEvictableSlot();
+  bool readRequestBody(ClientSlot &slot);
   void sendWebSocketUpdate(WiFiClient &client, const String &data);
-  String getDeviceStatesJSON();
-  String getShieldMaskJSON();
-  String getHTMLPage();
-  String getBaselineDelayJSON();
-  String getTriggerFilterJSON();
+  void writeDeviceStatesJSON(Print &out, int onlyDevice);
+  void writeShieldMaskJSON(Print &out);
+  void writeZonesJSON(Print &out);
 
 public:
   LaserWebServer();
@@ -51,13 +242,20 @@ public:
   bool getShieldState(uint8_t deviceAddr, uint8_t inputNum);
   void loadShielding(uint8_t shielding[4][48]);
   void clearShielding();
+  int applyShieldingBatch(uint8_t shielding[4][48]);
   
   void setShieldingChangeCallback(ShieldingChangeCallback callback);
   void setClearShieldingCallback(ClearShieldingCallback callback);
+  void setShieldingBatchCallback(ShieldingBatchCallback callback);
   
   void setTriggerFilterThreshold(int threshold);
   int getTriggerFilterThreshold();
   void setTriggerFilterCallback(TriggerFilterCallback callback);
+
+  void setZones(const Zone *zones, uint8_t count);
+  void setZonesCallback(ZonesChangeCallback callback);
+  void setCalibrationCallback(CalibrationCallback callback);
+  void setProfileCallback(ProfileCallback callback);
 };
 
 #endif
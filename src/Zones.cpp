@@ -0,0 +1,84 @@
+#include "Zones.h"
+#include <cstdlib>
+#include <cstring>
+
+static void setBeam(uint64_t mask[ZONE_DEVICES], int beam) {
+  int index = beam - 1;
+  mask[index / ZONE_INPUTS_PER_DEVICE] |= 1ULL << (index % ZONE_INPUTS_PER_DEVICE);
+}
+
+bool parseBeamRanges(const char *text, uint64_t mask[ZONE_DEVICES]) {
+  memset(mask, 0, sizeof(uint64_t) * ZONE_DEVICES);
+  const char *p = text;
+  while (*p) {
+    while (*p == ' ')
+      p++;
+    char *end;
+    long first = strtol(p, &end, 10);
+    if (end == p)
+      return false;
+    long last = first;
+    p = end;
+    if (*p == '-') {
+      p++;
+      last = strtol(p, &end, 10);
+      if (end == p)
+        return false;
+      p = end;
+    }
+    if (first < 1 || last > ZONE_TOTAL_BEAMS || first > last)
+      return false;
+    for (long beam = first; beam <= last; beam++)
+      setBeam(mask, beam);
+    while (*p == ' ')
+      p++;
+    if (*p == ',')
+      p++;
+    else if (*p)
+      return false;
+  }
+  return true;
+}
+
+static void printRange(Print &out, int start, int end, bool &first) {
+  if (!first)
+    out.print(',');
+  first = false;
+  if (start == end)
+    out.print(start + 1);
+  else
+    out.printf("%d-%d", start + 1, end + 1);
+}
+
+// 用 CTZ 逐段提取连续置位
+void printBeamRanges(Print &out, const uint64_t mask[ZONE_DEVICES]) {
+  int runStart = -1, runEnd = -1; // 全局 0 基编号
+  bool first = true;
+  for (int d = 0; d < ZONE_DEVICES; d++) {
+    uint64_t word = mask[d];
+    int base = d * ZONE_INPUTS_PER_DEVICE;
+    while (word) {
+      int start = __builtin_ctzll(word);
+      int len = __builtin_ctzll(~(word >> start)); // word 仅低 48 位有效，必有 0
+      word &= ~(((1ULL << len) - 1) << start);
+      if (runStart >= 0 && runEnd == base + start - 1) {
+        runEnd = base + start + len - 1; // 与上一段相连 (含跨设备)
+        continue;
+      }
+      if (runStart >= 0)
+        printRange(out, runStart, runEnd, first);
+      runStart = base + start;
+      runEnd = base + start + len - 1;
+    }
+  }
+  if (runStart >= 0)
+    printRange(out, runStart, runEnd, first);
+}
+
+int countZoneBits(const uint64_t mask[ZONE_DEVICES],
+                  const uint64_t bits[ZONE_DEVICES]) {
+  int count = 0;
+  for (int d = 0; d < ZONE_DEVICES; d++)
+    count += __builtin_popcountll(mask[d] & bits[d]);
+  return count;
+}
@@ -0,0 +1,37 @@
+#ifndef ZONES_H
+#define ZONES_H
+
+#include <Arduino.h>
+
+#ifndef MAX_ZONES
+#define MAX_ZONES 8
+#endif
+
+#define ZONE_DEVICES 4
+#define ZONE_INPUTS_PER_DEVICE 48
+#define ZONE_TOTAL_BEAMS (ZONE_DEVICES * ZONE_INPUTS_PER_DEVICE)
+#define ZONE_NAME_LEN 16
+#define ZONE_TOPIC_LEN 48
+
+// 逻辑分区：全局光束编号 1..192 (设备 d 的输入 i 为 (d-1)*48+i) 上的任意集合，
+// 可跨越接收器边界，拥有独立的容差、去抖、过滤上限和 MQTT 主题
+struct Zone {
+  uint8_t enabled;
+  char name[ZONE_NAME_LEN];
+  char topic[ZONE_TOPIC_LEN];
+  uint64_t mask[ZONE_DEVICES]; // mask[d] 的 bit i = 设备 d+1 输入 i+1
+  uint8_t tolerance;           // 确认缺失的光束数达到该值触发
+  uint16_t windowMs;           // 去抖窗口
+  uint16_t debounceMs;         // 窗口内累计缺失时长
+  uint16_t filterCeiling;      // 分区内同时缺失 >= 该值视为误触发，0 = 不过滤
+};
+
+// 解析 "1-20,49,60-64" 形式的全局编号区间，格式错误或越界返回 false
+bool parseBeamRanges(const char *text, uint64_t mask[ZONE_DEVICES]);
+// 输出为区间文本，跨设备连续的编号合并为一个区间
+void printBeamRanges(Print &out, const uint64_t mask[ZONE_DEVICES]);
+// 分区掩码与各设备位图相交后的置位数
+int countZoneBits(const uint64_t mask[ZONE_DEVICES],
+                  const uint64_t bits[ZONE_DEVICES]);
+
+#endif
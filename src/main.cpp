@@ -1,5 +1,24 @@
+#include "BaselineAccumulator.h"
+#include "BeamAvailability.h"
+#include "BeamStats.h"
+#include "Calibrator.h"
+#include "ConfigRecord.h"
+#include "DebounceEngine.h"
+#include "DetectionConfig.h"
+#include "Metrics.h"
+#include "MotionEstimator.h"
+#include "OcclusionAnalyzer.h"
+#include "PerfStats.h"
+#include "Profiles.h"
+#include "ResponseWriter.h"
+#include "ScanWindow.h"
+#include "Tracer.h"
+#include "TriggerArm.h"
+#include "TriggerLatency.h"
 #include "WebServer.h"
+#include "Zones.h"
 #include <Arduino.h>
+#include <ArduinoJson.h>
 #include <HardwareSerial.h>
 #include <Preferences.h>
 #include <PubSubClient.h>
@@ -29,6 +48,10 @@ const char *mqtt_topic = "receiver/triggered";
 const char *changeState_topic = "changeState";
 const char *btn_resetAll_topic = "btn/resetAll";
 const char *debug_printBaseline_topic = "debug/printBaseline";
+const char *motion_topic = "receiver/motion";
+const char *calibrate_topic = "calibrate";
+const char *config_topic = "config";
+const char *profile_topic = "profile";
 
 // ============== Modbus 设备设置 ==============
 #define BAUD_RATE 115200
@@ -43,19 +66,78 @@ const char *debug_printBaseline_topic = "debug/printBaseline";
 //    含义：该设备当前有效点数比基线少多少时，视为“异常”。
 //    数组顺序：{设备1设置, 设备2设置, 设备3设置, 设备4设置}
 //    建议：环境好的设备设为 1，灰尘多或不重要的设备设为 2 或 3。
+//    注意：本区的容差、去抖、宽度、基线参数均为出厂默认值，运行时以 DetectionConfig 为准，
+//          可经 /api/config、MQTT config 或自动校准在线修改，保存后优先使用。
 const int DEVICE_TOLERANCE[NUM_DEVICES] = {1, 1, 1, 1};
 
-// 2. [独立去抖] 连续确认次数 (Debounce)
-//    含义：该设备必须“连续”多少次扫描都处于异常状态，才触发最终报警。
+// 2. [独立去抖] 逐光束滑动窗口去抖 (Debounce，单位毫秒)
+//    含义：在最近 WINDOW_MS 内，某路光束累计缺失达到 MISSING_MS 才算“确认缺失”，
+//          确认缺失的光束数达到容差才触发报警。闪烁的遮挡物不会被单次正常扫描清零。
 //    数组顺序：{设备1设置, 设备2设置, 设备3设置, 设备4设置}
-//    建议：需要极快响应设为 1 或 2，需要极高抗干扰设为 3 到 5。
-//    注意：扫描间隔约 30ms，设置为 3 大约意味着持续遮挡 90ms 才报警。
-const int DEVICE_DEBOUNCE[NUM_DEVICES] = {2, 2, 2, 2};
-
-unsigned long baselineDelay = 350;       // 基线设置延迟，单位毫秒
+//    建议：需要极快响应把 MISSING_MS 设为约 1~2 个扫描周期，需要极高抗干扰设为 100~150。
+//    注意：按实测扫描周期 (约 30ms) 换算为扫描次数，扫描速率变化时时间行为不变。
+const uint16_t DEVICE_DEBOUNCE_WINDOW_MS[NUM_DEVICES] = {90, 90, 90, 90};
+const uint16_t DEVICE_DEBOUNCE_MISSING_MS[NUM_DEVICES] = {60, 60, 60, 60};
+
+// 2b. [最小遮挡宽度] 确认缺失的光束中至少有一段连续宽度达到该值才触发
+//    含义：设为 1 不限制；设为 2~3 时零散分布的灰尘/噪声缺失即使数量达到容差也不会触发，
+//          只有成片遮挡 (物体) 才会触发。
+const uint8_t DEVICE_MIN_RUN_WIDTH[NUM_DEVICES] = {1, 1, 1, 1};
+
+// 2c. [安装位置] 各接收器沿传送方向的位置 (毫米)，用于估计物体速度、方向和长度
+//    含义：物体先后遮挡两台位置不同的设备时，按断光/复光时间差计算并发布到 receiver/motion。
+//    全部为 0 (默认) 表示未配置几何信息，不做估计。
+const int32_t DEVICE_POSITION_MM[NUM_DEVICES] = {0, 0, 0, 0};
+
+const uint16_t BASELINE_DELAY_MS = 350;         // 基线设置延迟，单位毫秒
 unsigned long scanInterval = 700;        // 扫描间隔，单位毫秒
-unsigned long baselineScanInterval = 35; // 基线扫描间隔，单位毫秒
+const uint16_t BASELINE_SCAN_INTERVAL_MS = 35;  // 基线扫描间隔，单位毫秒
 unsigned long baselineStableTime = 100;  // 基线稳定时间，单位毫秒
+const uint16_t BACKGROUND_SCAN_INTERVAL_MS = 50; // 未监测时后台扫描间隔，保持滚动窗口新鲜
+
+// 3. [基线投票] 基线由 BASELINE_SAMPLES 次扫描组成，某路输入至少 BASELINE_MIN_VOTES 次为 1
+//    才计入基线。两者相等即严格 AND；如 5 次取 4 次可容忍建立基线时的单次闪烁。
+const uint8_t BASELINE_SAMPLES = 3;
+const uint8_t BASELINE_MIN_VOTES = 3;
+
+// 4. [快速重建基线] 直接用滚动窗口中最近 BASELINE_SAMPLES 次扫描投票得到基线，
+//    停机时间约一个扫描周期。changeState 负载为 "fast" / "full" 时强制选择模式，
+//    空负载使用 FAST_REBASELINE。
+#ifndef FAST_REBASELINE
+#define FAST_REBASELINE 0
+#endif
+#ifndef FAST_REBASELINE_MAX_AGE_MS
+#define FAST_REBASELINE_MAX_AGE_MS 300 // 窗口中可用扫描的最大年龄
+#endif
+#ifndef FAST_REBASELINE_CONFIRM
+#define FAST_REBASELINE_CONFIRM 1 // 1 = 计算后再做一次确认扫描
+#endif
+
+// 5. [光束可用率] 后台统计每路基线光束的在线比例 (约 1 分钟时间常数)，
+//    低于 AVAIL_LOW_PERCENT 时标记并记录日志，回升到 AVAIL_RECOVER_PERCENT 以上解除。
+//    AVAILABILITY_ACTION：0 = 仅标记，1 = 自动屏蔽 (写入 Flash)，2 = 从当前基线中移除
+#ifndef AVAILABILITY_ACTION
+#define AVAILABILITY_ACTION 0
+#endif
+
+// 6. [重新布防] 触发后相关光束全部恢复并持续 clearMs、且距上次触发超过 refractoryMs，
+//    设备级触发和各分区各自重新布防，可在同一基线周期内多次触发；每分钟最多 maxPerMinute 次。
+//    TRIGGER_REARM 设为 0 恢复旧行为：触发一次后锁定直到下一次 changeState。
+#ifndef TRIGGER_REARM
+#define TRIGGER_REARM 1
+#endif
+//                                       {rearm, clearMs, refractoryMs, maxPerMinute}
+const ReArmPolicy TRIGGER_REARM_POLICY = {TRIGGER_REARM, 300, 1000, 20};
+
+// 7. [触发负载] receiver/triggered 与分区主题的负载编码，两种格式字段相同
+//    TRIGGER_PAYLOAD_JSON：0 = MessagePack (紧凑二进制，默认)，1 = JSON 文本
+//    TRIGGER_PUBLISH_FILTERED：1 = 被过滤阈值拦截的触发也发布 (filtered 为 true，seq 为 0)
+#ifndef TRIGGER_PAYLOAD_JSON
+#define TRIGGER_PAYLOAD_JSON 0
+#endif
+#ifndef TRIGGER_PUBLISH_FILTERED
+#define TRIGGER_PUBLISH_FILTERED 0
+#endif
 // ==============================================================================
 
 // ============== 系统状态机 ==============
@@ -63,9 +145,8 @@ enum SystemState {
   IDLE,
   ACTIVE,
   BASELINE_WAITING,
-  BASELINE_INIT_0,
-  BASELINE_INIT_1,
-  BASELINE_INIT_2,
+  BASELINE_SCANNING, // 逐次采集 baselineSamples 次扫描 (见 DetectionConfig)
+  BASELINE_CONFIRM, // 快速基线的确认扫描
   BASELINE_CALC,
   BASELINE_ACTIVE
 };
@@ -86,17 +167,19 @@ unsigned long lastReadFailTime = 0;
 // ============== 基线变量 ==============
 unsigned long baselineSetTime = 0;
 unsigned long lastBaselineCheck = 0;
+unsigned long lastBackgroundScan = 0;
+
+// [新增] 最近扫描的位压缩滚动窗口 (监测、基线和后台扫描都会写入)
+ScanWindow scanWindow;
 
 uint8_t baseline[NUM_DEVICES][NUM_INPUTS_PER_DEVICE];
-uint8_t init_0[NUM_DEVICES][NUM_INPUTS_PER_DEVICE];
-uint8_t init_1[NUM_DEVICES][NUM_INPUTS_PER_DEVICE];
-uint8_t init_2[NUM_DEVICES][NUM_INPUTS_PER_DEVICE];
+BaselineAccumulator baselineAccumulator;
 
 // 存储每个设备独立的基线总点数
 int baselineDeviceCounts[NUM_DEVICES];
 
-// [新增] 存储每个设备当前的连续异常计数
-int currentConsecutiveErrors[NUM_DEVICES];
+// [新增] 逐光束去抖引擎
+DebounceEngine debounce;
 
 // [新增] 设备读取失败计数（策略C）
 int deviceReadFailCount[NUM_DEVICES];
@@ -105,27 +188,193 @@ const int READ_FAIL_THRESHOLD = 3;  // 连续失败3次才认为设备异常
 // [新增] 触发点过滤阈值（大于此数量的点同时触发则过滤）
 int triggerFilterThreshold = 20;  // 默认20个点
 
-bool triggerSent = false;
-
-// [新增] 加载/保存屏蔽配置
-void loadShieldingConfig() {
-  preferences.begin("shielding", false);
-  size_t read =
-      preferences.getBytes("mask", globalShielding, sizeof(globalShielding));
-  if (read != sizeof(globalShielding)) {
-    memset(globalShielding, 0, sizeof(globalShielding));
-    Serial.println("No shielding config found, initialized to 0");
-  } else {
-    Serial.println("Shielding config loaded from Flash");
+// [新增] 端到端触发延迟的时间戳 (micros())，并标记各设备是否处于一次缺失过程中
+TriggerLatency latency;
+
+// [新增] 连续遮挡段分析，确认触发时随触发事件保存
+OcclusionAnalyzer occlusion;
+
+// [新增] 设备级触发的重新布防状态机
+TriggerArm triggerArm;
+bool deviceFiltered = false; // 已被过滤阈值拦截，重新清除前不重复计数和发布
+
+// [新增] 待发布的触发事件队列，MQTT 断线时按顺序保留，重连后逐条发布
+#ifndef TRIGGER_QUEUE_SIZE
+#define TRIGGER_QUEUE_SIZE 8
+#endif
+// 分区名称和主题在入队时复制，断线期间修改分区表或切换方案不影响已排队的事件
+struct TriggerEvent {
+  int8_t zone;  // -1 = 设备级触发，否则为入队时的分区下标
+  char zoneName[ZONE_NAME_LEN];
+  char topic[ZONE_TOPIC_LEN];
+  uint32_t seq; // 该触发源的序号，被过滤的事件为 0
+  bool filtered;
+  uint8_t devices; // 触发的设备 (按位，bit d = 设备 d+1)
+  int confirmed;
+  int missing;
+  uint64_t missingBits[NUM_DEVICES]; // 确认时各设备的缺失光束 (分区事件只含分区内)
+  LatencyStamp stamp; // 分区事件只有 confirmUs
+  OcclusionAnalyzer occlusion;
+};
+TriggerEvent triggerQueue[TRIGGER_QUEUE_SIZE];
+uint8_t triggerQueueHead = 0;
+uint8_t triggerQueueCount = 0;
+
+// 队列已满时丢弃新事件并返回 nullptr
+TriggerEvent *queueTrigger() {
+  if (triggerQueueCount >= TRIGGER_QUEUE_SIZE) {
+    Serial.println("Trigger queue full - event dropped");
+    return nullptr;
   }
+  TriggerEvent *event =
+      &triggerQueue[(triggerQueueHead + triggerQueueCount) % TRIGGER_QUEUE_SIZE];
+  triggerQueueCount++;
+  return event;
+}
+
+// 设备级事件：时间戳取触发设备中最早的缺失扫描，遮挡段取本轮分析结果
+void queueDeviceTrigger(uint32_t seq, bool filtered, uint8_t devices,
+                        int missing, const uint64_t missingBits[NUM_DEVICES]) {
+  TriggerEvent *event = queueTrigger();
+  if (!event)
+    return;
+  event->zone = -1;
+  event->zoneName[0] = '\0';
+  strlcpy(event->topic, mqtt_topic, sizeof(event->topic));
+  event->seq = seq;
+  event->filtered = filtered;
+  event->devices = devices;
+  event->confirmed = 0;
+  event->missing = missing;
+  memcpy(event->missingBits, missingBits, sizeof(event->missingBits));
+  event->stamp = latency.stamp(micros());
+  event->occlusion = occlusion;
+}
+
+// [新增] 跨设备的速度/方向/长度估计，结果在主循环中发布
+MotionEstimator motion;
+bool motionPending = false;
+
+// 清空去抖历史 (重新建立基线时)
+void resetDebounce() {
+  debounce.reset();
+  latency.resetEpisodes();
+}
+
+// [新增] 分区检测：跨设备的光束分组，独立的容差、去抖、过滤上限和 MQTT 主题，
+// 与设备级判断并行，复用同一份去抖历史
+Zone zones[MAX_ZONES];
+uint8_t zoneCount = 0;
+TriggerArm zoneArm[MAX_ZONES]; // 各分区独立的重新布防状态机
+bool zoneFiltered[MAX_ZONES];  // 已被过滤上限拦截，分区清空前不重复计数
+
+void resetZones() {
+  for (int z = 0; z < MAX_ZONES; z++)
+    zoneArm[z].reset();
+  memset(zoneFiltered, 0, sizeof(zoneFiltered));
+}
+
+// 旧版单独保存在 "zones" 命名空间的分区表，只在迁移到 ConfigRecord 时读取一次
+void loadLegacyZones() {
+  preferences.begin("zones", true);
+  zoneCount = preferences.getUChar("count", 0);
+  size_t size = sizeof(Zone) * zoneCount;
+  if (zoneCount > MAX_ZONES ||
+      (size > 0 && preferences.getBytes("table", zones, size) != size))
+    zoneCount = 0;
   preferences.end();
-  webServer.loadShielding(globalShielding);
+  Serial.printf("Legacy zones migrated: %d\n", zoneCount);
+}
+
+// [新增] Web 端修改分区的回调
+void onZonesChanged(const Zone *newZones, uint8_t count) {
+  memcpy(zones, newZones, sizeof(Zone) * count);
+  zoneCount = count;
+  configJournal.markDirty(CONFIG_DIRTY_RECORD, millis());
+  resetZones();
+}
+
+// [新增] 检测参数：出厂默认值取核心配置区，Flash 中有合法配置时优先使用
+DetectionConfig defaultDetectionConfig() {
+  DetectionConfig config;
+  memset(&config, 0, sizeof(config));
+  config.version = DETECTION_CONFIG_VERSION;
+  for (int d = 0; d < NUM_DEVICES; d++) {
+    config.tolerance[d] = DEVICE_TOLERANCE[d];
+    config.debounceWindowMs[d] = DEVICE_DEBOUNCE_WINDOW_MS[d];
+    config.debounceMissingMs[d] = DEVICE_DEBOUNCE_MISSING_MS[d];
+    config.minRunWidth[d] = DEVICE_MIN_RUN_WIDTH[d];
+  }
+  config.baselineDelayMs = BASELINE_DELAY_MS;
+  config.baselineScanIntervalMs = BASELINE_SCAN_INTERVAL_MS;
+  config.backgroundScanIntervalMs = BACKGROUND_SCAN_INTERVAL_MS;
+  config.baselineSamples = BASELINE_SAMPLES;
+  config.baselineMinVotes = BASELINE_MIN_VOTES;
+  return config;
+}
+
+// [新增] 扫描边界：切换到排队中的配置，只重新配置实际变化的部分，不清空去抖历史
+void applyPendingConfig() {
+  const DetectionConfig *previous = detectionConfig.commit();
+  if (previous == nullptr)
+    return;
+  const DetectionConfig &config = detectionConfig.current();
+  for (int d = 0; d < NUM_DEVICES; d++) {
+    if (config.debounceWindowMs[d] != previous->debounceWindowMs[d] ||
+        config.debounceMissingMs[d] != previous->debounceMissingMs[d])
+      debounce.configure(d, config.debounceWindowMs[d],
+                         config.debounceMissingMs[d]);
+  }
+  webServer.setBaselineDelay(config.baselineDelayMs);
+  configJournal.markDirty(CONFIG_DIRTY_RECORD, millis());
+  Serial.printf("Detection config rev %lu applied\n",
+                (unsigned long)config.revision);
+}
+
+// [新增] 排队一份新配置 (REST、MQTT 与校准共用)，在下一个扫描边界生效；
+// 返回错误说明，成功返回 nullptr
+const char *stageDetectionConfig(const DetectionConfig &config) {
+  const char *error = detectionConfig.stage(config);
+  if (error)
+    Serial.printf("Detection config rejected: %s\n", error);
+  return error;
+}
+
+// [新增] 校准完成：排队生效并保存
+void applyCalibration() {
+  const CalibrationResult &result = calibrator.getResult();
+  DetectionConfig config = detectionConfig.latest();
+  Serial.println("=== CALIBRATION DONE ===");
+  for (int d = 0; d < NUM_DEVICES; d++) {
+    config.tolerance[d] = result.tolerance[d];
+    config.debounceWindowMs[d] = result.windowMs[d];
+    config.debounceMissingMs[d] = result.missingMs[d];
+    Serial.printf("Dev %d: tolerance %d, debounce %u/%u ms%s\n", d + 1,
+                  result.tolerance[d], result.missingMs[d], result.windowMs[d],
+                  result.met[d] ? "" : " (target not met)");
+  }
+  // 未能生效时通过 /api/calibration 的 applied/error 报告，不只留在串口
+  calibrator.setApplyError(stageDetectionConfig(config));
 }
 
+// [新增] 开始/取消校准 (Web 与 MQTT 共用)，只能在监测状态下进行
+bool onCalibrationRequested(uint16_t minutes) {
+  if (minutes == 0) {
+    calibrator.cancel();
+    Serial.println("Calibration cancelled");
+    return true;
+  }
+  if (currentState != BASELINE_ACTIVE ||
+      !calibrator.start(minutes, millis()))
+    return false;
+  Serial.printf("=== CALIBRATION STARTED: %u min, keep beams clear ===\n",
+                minutes);
+  return true;
+}
+
+// [新增] 屏蔽变化：经写回日志合并，静默后与其它配置一起写入 Flash
 void saveShieldingConfig() {
-  preferences.begin("shielding", false);
-  preferences.putBytes("mask", globalShielding, sizeof(globalShielding));
-  preferences.end();
+  configJournal.markDirty(CONFIG_DIRTY_RECORD, millis());
 
   // Enhanced logging
   int totalShielded = 0;
@@ -138,30 +387,274 @@ void saveShieldingConfig() {
     totalShielded += deviceShielded;
     Serial.printf("Device %d: %d points shielded\n", d + 1, deviceShielded);
   }
-  Serial.printf("Total: %d/192 points shielded, saved to Flash\n",
+  Serial.printf("Total: %d/192 points shielded, queued for Flash\n",
                 totalShielded);
 }
 
-// [新增] 加载触发过滤阈值
-void loadTriggerFilterThreshold() {
-  preferences.begin("trigger", false);
+// [新增] 设置触发过滤阈值的回调
+void onTriggerFilterThresholdChanged(int threshold) {
+  triggerFilterThreshold = threshold;
+  configJournal.markDirty(CONFIG_DIRTY_RECORD, millis());
+  Serial.printf("Trigger filter threshold set: %d\n", threshold);
+}
+
+void saveBaselineSnapshot();
+
+// [新增] 统一配置记录：屏蔽 (按位)、过滤阈值、检测参数和分区表合为一条带 CRC 的记录
+uint32_t configSequence = 0;
+
+void writeConfigRecord() {
+  TRACE_SCOPE("nvs.saveConfig");
+  ConfigRecord record;
+  memset(&record, 0, sizeof(record));
+  record.sequence = ++configSequence;
+  packShielding(globalShielding, record.shielding);
+  record.triggerFilterThreshold = triggerFilterThreshold;
+  record.detection = detectionConfig.current();
+  record.zoneCount = zoneCount;
+  memcpy(record.zones, zones, sizeof(Zone) * zoneCount);
+  sealConfigRecord(record);
+  preferences.begin("config", false);
+  preferences.putBytes("record", &record, sizeof(record));
+  preferences.end();
+  Serial.printf("Config record #%lu saved to Flash (%u bytes)\n",
+                (unsigned long)record.sequence, (unsigned)sizeof(record));
+}
+
+// 旧版按命名空间分别保存的配置，只在没有合法记录时读取一次
+void loadLegacyConfig() {
+  preferences.begin("shielding", true);
+  size_t read =
+      preferences.getBytes("mask", globalShielding, sizeof(globalShielding));
+  preferences.end();
+  if (read != sizeof(globalShielding))
+    memset(globalShielding, 0, sizeof(globalShielding));
+
+  preferences.begin("trigger", true);
   triggerFilterThreshold = preferences.getInt("filterThreshold", 20);
   preferences.end();
-  Serial.printf("Trigger filter threshold loaded: %d\n", triggerFilterThreshold);
+
+  // 检测参数在此之前只有编译期常量，取默认值
+  DetectionConfig config = defaultDetectionConfig();
+  detectionConfig.begin(config);
+  loadLegacyZones();
 }
 
-// [新增] 保存触发过滤阈值
-void saveTriggerFilterThreshold(int threshold) {
-  preferences.begin("trigger", false);
-  preferences.putInt("filterThreshold", threshold);
+// 新记录写入成功后再删除旧命名空间，迁移中途断电不会丢失配置
+void clearLegacyConfig() {
+  const char *namespaces[] = {"shielding", "trigger", "zones"};
+  for (const char *ns : namespaces) {
+    preferences.begin(ns, false);
+    preferences.clear();
+    preferences.end();
+  }
+}
+
+void loadConfig() {
+  ConfigRecord record;
+  preferences.begin("config", true);
+  size_t length = preferences.getBytesLength("record");
+  size_t read = length == sizeof(record)
+                    ? preferences.getBytes("record", &record, sizeof(record))
+                    : 0;
+  ConfigRecordV1 recordV1;
+  bool haveV1 = length == sizeof(recordV1) &&
+                preferences.getBytes("record", &recordV1, sizeof(recordV1)) ==
+                    sizeof(recordV1) &&
+                verifyConfigRecordV1(recordV1);
   preferences.end();
-  Serial.printf("Trigger filter threshold saved: %d\n", threshold);
+  if (read == sizeof(record) && verifyConfigRecord(record)) {
+    configSequence = record.sequence;
+    unpackShielding(record.shielding, globalShielding);
+    triggerFilterThreshold = record.triggerFilterThreshold;
+    detectionConfig.begin(record.detection);
+    zoneCount = record.zoneCount;
+    memcpy(zones, record.zones, sizeof(zones));
+    Serial.printf("Config record #%lu loaded (detection rev %lu, %d zones)\n",
+                  (unsigned long)record.sequence,
+                  (unsigned long)record.detection.revision, zoneCount);
+    return;
+  }
+
+  if (haveV1) {
+    // 版本 1：屏蔽、阈值和检测参数取自旧记录，分区表取自 "zones" 命名空间
+    Serial.println("Config record v1, migrating zones into record");
+    configSequence = recordV1.sequence;
+    unpackShielding(recordV1.shielding, globalShielding);
+    triggerFilterThreshold = recordV1.triggerFilterThreshold;
+    detectionConfig.begin(recordV1.detection);
+    loadLegacyZones();
+    writeConfigRecord();
+    clearLegacyConfig();
+    return;
+  }
+
+  Serial.println(length > 0 ? "Config record invalid (version/CRC), rebuilding"
+                            : "No config record, migrating legacy config");
+  loadLegacyConfig();
+  writeConfigRecord();
+  clearLegacyConfig();
 }
 
-// [新增] 设置触发过滤阈值的回调
-void onTriggerFilterThresholdChanged(int threshold) {
-  triggerFilterThreshold = threshold;
-  saveTriggerFilterThreshold(threshold);
+// [新增] 配置方案：每个槽位一个 blob，常驻内存，切换时不读 Flash
+void loadProfiles() {
+  Profile profile;
+  char key[4];
+  preferences.begin("profiles", false);
+  for (int i = 0; i < MAX_PROFILES; i++) {
+    snprintf(key, sizeof(key), "p%d", i);
+    if (preferences.getBytes(key, &profile, sizeof(profile)) ==
+            sizeof(profile) &&
+        !profiles.restore(i, profile))
+      Serial.printf("Profile slot %d invalid, ignored\n", i);
+  }
+  int active = preferences.getChar("active", -1);
+  preferences.end();
+  if (profiles.get(active) != nullptr)
+    profiles.setActive(active);
+}
+
+void saveProfiles() {
+  TRACE_SCOPE("nvs.saveProfiles");
+  uint8_t slots = profiles.takeDirty();
+  char key[4];
+  preferences.begin("profiles", false);
+  for (int i = 0; i < MAX_PROFILES; i++) {
+    if (!(slots & (1 << i)))
+      continue;
+    snprintf(key, sizeof(key), "p%d", i);
+    const Profile *profile = profiles.get(i);
+    if (profile != nullptr)
+      preferences.putBytes(key, profile, sizeof(Profile));
+    else
+      preferences.remove(key);
+  }
+  preferences.putChar("active", profiles.getActive());
+  preferences.end();
+}
+
+void recalculateBaselineCounts();
+
+// [新增] 切换方案：方案常驻内存，只做定长拷贝，检测参数经 DetectionConfig 指针交换在
+// 扫描边界生效；基线保持不变，只按新的屏蔽重新计数
+bool activateProfile(const char *name) {
+  int index = profiles.find(name);
+  const Profile *profile = profiles.get(index);
+  if (profile == nullptr)
+    return false;
+
+  unpackShielding(profile->shielding, globalShielding);
+  webServer.loadShielding(globalShielding);
+  triggerFilterThreshold = profile->triggerFilterThreshold;
+  webServer.setTriggerFilterThreshold(triggerFilterThreshold);
+  memcpy(zones, profile->zones, sizeof(zones));
+  zoneCount = profile->zoneCount;
+  webServer.setZones(zones, zoneCount);
+  resetZones();
+  stageDetectionConfig(profile->detection);
+  profiles.setActive(index);
+
+  recalculateBaselineCounts();
+  configJournal.markDirty(CONFIG_DIRTY_RECORD | CONFIG_DIRTY_PROFILES,
+                          millis());
+  Serial.printf("Profile '%s' activated\n", profile->name);
+  return true;
+}
+
+// [新增] Web 与 MQTT 共用的方案操作
+bool onProfileRequested(ProfileAction action, const char *name) {
+  if (action == PROFILE_ACTIVATE)
+    return activateProfile(name);
+
+  if (action == PROFILE_DELETE) {
+    if (!profiles.remove(name))
+      return false;
+    Serial.printf("Profile '%s' deleted\n", name);
+  } else {
+    Profile profile;
+    memset(&profile, 0, sizeof(profile));
+    strncpy(profile.name, name, PROFILE_NAME_LEN - 1);
+    packShielding(globalShielding, profile.shielding);
+    profile.triggerFilterThreshold = triggerFilterThreshold;
+    profile.detection = detectionConfig.latest();
+    profile.zoneCount = zoneCount;
+    memcpy(profile.zones, zones, sizeof(Zone) * zoneCount);
+    int index = profiles.save(profile);
+    if (index < 0)
+      return false;
+    profiles.setActive(index);
+    Serial.printf("Profile '%s' saved to slot %d\n", name, index);
+  }
+  configJournal.markDirty(CONFIG_DIRTY_PROFILES, millis());
+  return true;
+}
+
+// [新增] 写回日志到期：合并期间的所有修改一次提交
+void flushConfigJournal() {
+  uint8_t what = configJournal.take();
+  if (what & CONFIG_DIRTY_RECORD)
+    writeConfigRecord();
+  if (what & CONFIG_DIRTY_PROFILES)
+    saveProfiles();
+  if ((what & CONFIG_DIRTY_SNAPSHOT) && currentState == BASELINE_ACTIVE)
+    saveBaselineSnapshot();
+}
+
+// [新增] 基线快照：断电重启后可经一次校验扫描直接恢复监测
+struct BaselineSnapshot {
+  uint32_t configHash; // 屏蔽配置与投票参数的哈希，不一致则不恢复
+  uint64_t bits[NUM_DEVICES];
+  int32_t counts[NUM_DEVICES]; // 屏蔽后的有效基线点数
+};
+
+// FNV-1a，覆盖影响基线含义的配置
+uint32_t baselineConfigHash() {
+  uint32_t hash = 2166136261u;
+  const uint8_t *p = &globalShielding[0][0];
+  for (size_t i = 0; i < sizeof(globalShielding); i++)
+    hash = (hash ^ p[i]) * 16777619u;
+  const DetectionConfig &config = detectionConfig.current();
+  const uint8_t params[] = {NUM_DEVICES, NUM_INPUTS_PER_DEVICE,
+                            config.baselineSamples, config.baselineMinVotes};
+  for (size_t i = 0; i < sizeof(params); i++)
+    hash = (hash ^ params[i]) * 16777619u;
+  return hash;
+}
+
+void saveBaselineSnapshot() {
+  BaselineSnapshot snapshot;
+  snapshot.configHash = baselineConfigHash();
+  for (int d = 0; d < NUM_DEVICES; d++) {
+    uint64_t bits = 0;
+    for (int i = 0; i < NUM_INPUTS_PER_DEVICE; i++)
+      if (baseline[d][i])
+        bits |= 1ULL << i;
+    snapshot.bits[d] = bits;
+    snapshot.counts[d] = baselineDeviceCounts[d];
+  }
+  preferences.begin("baseline", false);
+  preferences.putBytes("snapshot", &snapshot, sizeof(snapshot));
+  preferences.end();
+  Serial.println("Baseline snapshot saved to Flash");
+}
+
+// 人工解除监测后不应在重启时自动恢复
+void clearBaselineSnapshot() {
+  configJournal.discard(CONFIG_DIRTY_SNAPSHOT);
+  preferences.begin("baseline", false);
+  preferences.remove("snapshot");
+  preferences.end();
+}
+
+// [新增] 可用率只统计基线中且未屏蔽的光束
+void syncAvailabilityTracking() {
+  for (int d = 0; d < NUM_DEVICES; d++) {
+    uint64_t mask = 0;
+    for (int i = 0; i < NUM_INPUTS_PER_DEVICE; i++)
+      if (baseline[d][i] == 1 && !webServer.getShieldState(d + 1, i + 1))
+        mask |= 1ULL << i;
+    availability.setTracked(d, mask);
+  }
 }
 
 // [新增] 重新计算每个设备的有效基线点数
@@ -180,6 +673,11 @@ void recalculateBaselineCounts() {
     Serial.printf("Device %d Recalculated Baseline: %d\n", d + 1, deviceBits);
   }
   Serial.printf("Total Recalculated Baseline: %d / 192\n", totalBits);
+  syncAvailabilityTracking();
+
+  // 监测中屏蔽变化会改变计数与配置哈希，快照随配置一起经写回日志更新
+  if (currentState == BASELINE_ACTIVE)
+    configJournal.markDirty(CONFIG_DIRTY_SNAPSHOT, millis());
 }
 
 // Callback handler for shielding changes from WebServer
@@ -188,7 +686,7 @@ void onShieldingChanged(uint8_t deviceAddr, uint8_t inputNum, bool state) {
     // Update global storage
     globalShielding[deviceAddr - 1][inputNum - 1] = state ? 1 : 0;
 
-    // Save to Flash immediately
+    // 写回日志，静默后写入 Flash
     saveShieldingConfig();
 
     // Sync back to WebServer (fix refresh issue)
@@ -202,18 +700,27 @@ void onShieldingChanged(uint8_t deviceAddr, uint8_t inputNum, bool state) {
   }
 }
 
+// Callback handler for batched shielding changes from WebServer
+// 整批只记一次写回、只重算一次基线
+void onShieldingBatchChanged(uint8_t shielding[4][48], int changed) {
+  memcpy(globalShielding, shielding, sizeof(globalShielding));
+  saveShieldingConfig();
+  recalculateBaselineCounts();
+  Serial.printf("Shield batch applied: %d points changed\n", changed);
+}
+
 // Callback handler for clearing all shielding from WebServer
 void onClearShielding() {
   // Clear global storage
   memset(globalShielding, 0, sizeof(globalShielding));
   
-  // Save to Flash
+  // 写回日志，静默后写入 Flash
   saveShieldingConfig();
   
   // Recalculate baseline
   recalculateBaselineCounts();
   
-  Serial.println("All shielding cleared from Flash, baseline recalculated");
+  Serial.println("All shielding cleared, baseline recalculated");
 }
 
 void setup_wifi() {
@@ -251,12 +758,54 @@ void setup_wifi() {
   }
 }
 
+bool fastRebaseline();
+
 void callback(char *topic, byte *payload, unsigned int length) {
   Serial.printf("MQTT: [%s] %d bytes\n", topic, length);
 
   if (strcmp(topic, btn_resetAll_topic) == 0) {
     Serial.println("✓ btn/resetAll received, activating system");
     currentState = ACTIVE;
+    clearBaselineSnapshot();
+    return;
+  }
+
+  // [新增] 负载为 JSON，只需包含要修改的字段
+  if (strcmp(topic, config_topic) == 0) {
+    DetectionConfig config = detectionConfig.latest();
+    const char *error =
+        mergeDetectionConfigJSON((const char *)payload, length, config);
+    if (error)
+      Serial.printf("Detection config rejected: %s\n", error);
+    else
+      stageDetectionConfig(config);
+    return;
+  }
+
+  // [新增] 负载为方案名称
+  if (strcmp(topic, profile_topic) == 0) {
+    char name[PROFILE_NAME_LEN] = {0};
+    if (length < sizeof(name))
+      memcpy(name, payload, length);
+    if (!validProfileName(name) || !activateProfile(name))
+      Serial.printf("Profile switch rejected: unknown profile\n");
+    return;
+  }
+
+  // [新增] 负载为分钟数，只有明确的 "0" 才取消；非数字负载不能误取消正在进行的校准
+  if (strcmp(topic, calibrate_topic) == 0) {
+    char text[8] = {0};
+    long minutes = -1;
+    if (length > 0 && length < sizeof(text)) {
+      memcpy(text, payload, length);
+      char *end = nullptr;
+      minutes = strtol(text, &end, 10);
+      if (end == text || *end != '\0')
+        minutes = -1;
+    }
+    if (minutes < 0 || minutes > CAL_MAX_MINUTES ||
+        !onCalibrationRequested((uint16_t)minutes))
+      Serial.println("Calibration rejected (needs active baseline, 1-60 min)");
     return;
   }
 
@@ -268,20 +817,36 @@ void callback(char *topic, byte *payload, unsigned int length) {
       return;
     }
 
+    bool fast = FAST_REBASELINE;
+    if (length == 4 && strncmp((const char *)payload, "fast", 4) == 0)
+      fast = true;
+    else if (length == 4 && strncmp((const char *)payload, "full", 4) == 0)
+      fast = false;
+
+    // 新的基线周期重新布防；尚未发布的触发事件保留在队列中
+    triggerArm.reset();
+    deviceFiltered = false;
+    resetZones();
+    calibrator.cancel();
+    motion.reset();
+    motionPending = false;
+    availability.reset();
+
+    // 重置所有设备的去抖历史
+    resetDebounce();
+
+    if (fast && fastRebaseline())
+      return;
+
     Serial.println("\n=== START BASELINE SCANS ===");
     currentState = BASELINE_WAITING;
-    baselineSetTime = millis() + baselineDelay;
-    triggerSent = false;
-
-    // 重置所有设备的计数器
-    for (int i = 0; i < NUM_DEVICES; i++)
-      currentConsecutiveErrors[i] = 0;
-
+    baselineSetTime = millis() + detectionConfig.current().baselineDelayMs;
     return;
   }
 }
 
 void reconnect() {
+  TRACE_SCOPE("mqtt.reconnect");
   static unsigned long lastReconnectAttempt = 0;
   unsigned long now = millis();
 
@@ -292,8 +857,13 @@ void reconnect() {
       client.subscribe(changeState_topic);
       client.subscribe(btn_resetAll_topic);
       client.subscribe(debug_printBaseline_topic);
+      client.subscribe(calibrate_topic);
+      client.subscribe(config_topic);
+      client.subscribe(profile_topic);
+      metrics.mqttReconnects.inc();
       Serial.println("connected + subscribed");
     } else {
+      metrics.mqttConnectFailures.inc();
       Serial.printf("failed, rc=%d\n", client.state());
     }
   }
@@ -309,7 +879,10 @@ uint16_t crc16(const uint8_t *data, uint8_t length) {
   return crc;
 }
 
-bool readInputStatus(uint8_t deviceAddress, uint8_t *status_array) {
+// packed 非空时同时输出位压缩结果 (bit i = 输入 i+1)
+bool readInputStatus(uint8_t deviceAddress, uint8_t *status_array,
+                     uint64_t *packed = nullptr) {
+  TRACE_SCOPE("modbus.read");
   while (rs485Serial.available()) {
     rs485Serial.read();
   }
@@ -323,31 +896,49 @@ bool readInputStatus(uint8_t deviceAddress, uint8_t *status_array) {
   full_request[sizeof(request)] = crc & 0xFF;
   full_request[sizeof(request) + 1] = (crc >> 8) & 0xFF;
 
+  int deviceIdx = (deviceAddress - 1) % NUM_DEVICES; // 仅用于指标
+  unsigned long startMicros = micros();
+  uint32_t stamp = PerfStats::now();
+
   rs485Serial.write(full_request, sizeof(full_request));
+  rs485Serial.flush(); // 等待请求发送完毕，使发送与等待阶段可区分
+  perf.lap(deviceAddress, PHASE_TX, stamp);
 
   const int responseLength = 3 + (NUM_INPUTS_PER_DEVICE + 7) / 8 + 2;
   uint8_t response[responseLength];
 
-  unsigned long startMicros = micros();
   const unsigned long timeoutMicros = 50000;
+  bool gotFirstByte = false;
 
   while (rs485Serial.available() < responseLength) {
+    if (!gotFirstByte && rs485Serial.available() > 0) {
+      gotFirstByte = true;
+      perf.lap(deviceAddress, PHASE_WAIT, stamp);
+    }
     if (micros() - startMicros > timeoutMicros) {
       while (rs485Serial.available())
         rs485Serial.read();
+      metrics.timeouts[deviceIdx].inc();
       return false;
     }
     delayMicroseconds(50);
   }
+  if (!gotFirstByte)
+    perf.lap(deviceAddress, PHASE_WAIT, stamp);
 
   rs485Serial.readBytes(response, responseLength);
+  perf.lap(deviceAddress, PHASE_RX, stamp);
 
   uint16_t crc_rx =
       (response[responseLength - 1] << 8) | response[responseLength - 2];
   uint16_t crc_calc = crc16(response, responseLength - 2);
+  perf.lap(deviceAddress, PHASE_CRC, stamp);
 
-  if (crc_rx != crc_calc)
+  if (crc_rx != crc_calc) {
+    metrics.crcFailures[deviceIdx].inc();
     return false;
+  }
+  metrics.deviceRtt[deviceIdx].observe(micros() - startMicros);
 
   uint8_t byte_count = response[2];
   for (int i = 0; i < NUM_INPUTS_PER_DEVICE; i++) {
@@ -357,6 +948,13 @@ bool readInputStatus(uint8_t deviceAddress, uint8_t *status_array) {
                           ? (response[byte_index] >> bit_index) & 0x01
                           : 0;
   }
+  if (packed) {
+    uint64_t bits = 0;
+    for (int b = 0; b < (NUM_INPUTS_PER_DEVICE + 7) / 8 && b < byte_count; b++)
+      bits |= (uint64_t)response[3 + b] << (8 * b);
+    *packed = bits;
+  }
+  perf.lap(deviceAddress, PHASE_DECODE, stamp);
 
   return true;
 }
@@ -405,11 +1003,20 @@ int countSingleDeviceBits(int deviceIdx, uint8_t *deviceArr) {
   return cnt;
 }
 
-bool scanBaseline(uint8_t arr[NUM_DEVICES][NUM_INPUTS_PER_DEVICE]) {
+// [新增] 所有扫描都写入滚动窗口和逐光束闪烁统计
+void recordScan(const PackedScan &scan) {
+  scanWindow.push(scan);
+  beamStats.update(scan);
+}
+
+// packed 非空时同时输出位压缩结果
+bool scanBaseline(uint8_t arr[NUM_DEVICES][NUM_INPUTS_PER_DEVICE],
+                  PackedScan *packed = nullptr) {
+  PackedScan scan;
   for (int d = 1; d <= NUM_DEVICES; d++) {
     bool success = false;
     for (int retry = 0; retry < 3; retry++) {
-      if (readInputStatus(d, arr[d - 1])) {
+      if (readInputStatus(d, arr[d - 1], &scan.bits[d - 1])) {
         success = true;
         break;
       }
@@ -425,6 +1032,121 @@ bool scanBaseline(uint8_t arr[NUM_DEVICES][NUM_INPUTS_PER_DEVICE]) {
     }
     delay(3);
   }
+  scan.validMask = (1 << NUM_DEVICES) - 1;
+  scan.timeMs = millis();
+  recordScan(scan);
+  if (packed)
+    *packed = scan;
+  return true;
+}
+
+// [新增] 未监测时的后台扫描，只填充滚动窗口，失败不重试
+void backgroundScan() {
+  uint8_t states[NUM_INPUTS_PER_DEVICE];
+  PackedScan scan = {};
+  for (int d = 1; d <= NUM_DEVICES; d++) {
+    if (readInputStatus(d, states, &scan.bits[d - 1]))
+      scan.validMask |= 1 << (d - 1);
+    delay(3);
+  }
+  scan.timeMs = millis();
+  recordScan(scan);
+}
+
+// [新增] 快速重建基线：对滚动窗口中最近的扫描做 k-of-n 投票
+// 窗口中新鲜的完整扫描不足时返回 false，由调用方回退到完整流程
+bool fastRebaseline() {
+  const DetectionConfig &config = detectionConfig.current();
+  uint64_t voted[NUM_DEVICES];
+  if (!scanWindow.vote(config.baselineSamples, config.baselineMinVotes, millis(),
+                       FAST_REBASELINE_MAX_AGE_MS, voted)) {
+    Serial.println("Fast rebaseline: scan window stale, using full sequence");
+    return false;
+  }
+
+  for (int d = 0; d < NUM_DEVICES; d++)
+    for (int i = 0; i < NUM_INPUTS_PER_DEVICE; i++)
+      baseline[d][i] = (voted[d] >> i) & 1;
+  recalculateBaselineCounts();
+
+  Serial.printf("Fast rebaseline: %d-of-%d vote, %d active bits\n",
+                config.baselineMinVotes, config.baselineSamples,
+                countActiveBits(baseline));
+  currentState = FAST_REBASELINE_CONFIRM ? BASELINE_CONFIRM : BASELINE_ACTIVE;
+  if (currentState == BASELINE_ACTIVE)
+    saveBaselineSnapshot();
+  return true;
+}
+
+// [新增] 校验一次扫描是否与当前基线一致：任一设备缺失点数达到容差即不一致
+bool scanMatchesBaseline(uint8_t scan[NUM_DEVICES][NUM_INPUTS_PER_DEVICE],
+                         const char *label) {
+  for (int d = 0; d < NUM_DEVICES; d++) {
+    int missing = 0;
+    for (int i = 0; i < NUM_INPUTS_PER_DEVICE; i++) {
+      if (webServer.getShieldState(d + 1, i + 1))
+        continue;
+      if (baseline[d][i] && !scan[d][i])
+        missing++;
+    }
+    if (missing >= detectionConfig.current().tolerance[d]) {
+      Serial.printf("%s rejected: Dev %d missing %d bits\n", label, d + 1,
+                    missing);
+      return false;
+    }
+  }
+  return true;
+}
+
+// [新增] 快速基线的确认扫描：任一设备缺失点数达到容差则回退到完整流程
+void confirmFastBaseline() {
+  uint8_t confirmScan[NUM_DEVICES][NUM_INPUTS_PER_DEVICE];
+  bool ok = scanBaseline(confirmScan) &&
+            scanMatchesBaseline(confirmScan, "Fast rebaseline");
+
+  if (!ok) {
+    Serial.println("\n=== START BASELINE SCANS ===");
+    currentState = BASELINE_WAITING;
+    baselineSetTime = millis() + detectionConfig.current().baselineDelayMs;
+    return;
+  }
+  Serial.println("✓✓✓ BASELINE ESTABLISHED (fast) ✓✓✓");
+  currentState = BASELINE_ACTIVE;
+  saveBaselineSnapshot();
+}
+
+// [新增] 启动时恢复上次的基线：配置哈希一致且一次校验扫描通过则直接进入监测
+bool restoreBaselineSnapshot() {
+  BaselineSnapshot snapshot;
+  preferences.begin("baseline", true);
+  size_t read = preferences.getBytes("snapshot", &snapshot, sizeof(snapshot));
+  preferences.end();
+  if (read != sizeof(snapshot)) {
+    Serial.println("No baseline snapshot, waiting for changeState");
+    return false;
+  }
+  if (snapshot.configHash != baselineConfigHash()) {
+    Serial.println("Baseline snapshot config mismatch, waiting for changeState");
+    return false;
+  }
+
+  for (int d = 0; d < NUM_DEVICES; d++) {
+    for (int i = 0; i < NUM_INPUTS_PER_DEVICE; i++)
+      baseline[d][i] = (snapshot.bits[d] >> i) & 1;
+    baselineDeviceCounts[d] = snapshot.counts[d];
+  }
+  resetDebounce();
+  syncAvailabilityTracking();
+
+  uint8_t verifyScan[NUM_DEVICES][NUM_INPUTS_PER_DEVICE];
+  if (!scanBaseline(verifyScan) ||
+      !scanMatchesBaseline(verifyScan, "Baseline snapshot")) {
+    memset(baseline, 0, sizeof(baseline));
+    memset(baselineDeviceCounts, 0, sizeof(baselineDeviceCounts));
+    return false;
+  }
+
+  Serial.println("✓✓✓ BASELINE RESTORED FROM FLASH ✓✓✓");
   return true;
 }
 
@@ -432,18 +1154,17 @@ void calculateFinalBaseline() {
   memset(baseline, 0, sizeof(baseline));
   memset(baselineDeviceCounts, 0, sizeof(baselineDeviceCounts));
 
-  // 清零状态计数器
-  for (int i = 0; i < NUM_DEVICES; i++)
-    currentConsecutiveErrors[i] = 0;
+  // 清零去抖历史
+  resetDebounce();
 
   int totalBits = 0;
 
+  // 记录物理基线（不管是否屏蔽）
+  uint64_t voted[NUM_DEVICES];
+  baselineAccumulator.result(detectionConfig.current().baselineMinVotes, voted);
   for (int d = 0; d < NUM_DEVICES; d++) {
     for (int i = 0; i < NUM_INPUTS_PER_DEVICE; i++) {
-      // 记录物理基线（不管是否屏蔽）
-      if (init_0[d][i] && init_1[d][i] && init_2[d][i]) {
-        baseline[d][i] = 1;
-      }
+      baseline[d][i] = (voted[d] >> i) & 1;
     }
   }
 
@@ -457,24 +1178,168 @@ void calculateFinalBaseline() {
 
   currentState = BASELINE_ACTIVE;
   lastBaselineCheck = millis() + baselineStableTime;
+  saveBaselineSnapshot();
+}
+
+void queueZoneTrigger(int z, uint32_t seq, bool filtered, int confirmed,
+                      int missing, const uint64_t missingBits[NUM_DEVICES]) {
+  TriggerEvent *event = queueTrigger();
+  if (!event)
+    return;
+  event->zone = z;
+  strlcpy(event->zoneName, zones[z].name, sizeof(event->zoneName));
+  strlcpy(event->topic, zones[z].topic, sizeof(event->topic));
+  event->seq = seq;
+  event->filtered = filtered;
+  event->devices = 0;
+  event->confirmed = confirmed;
+  event->missing = missing;
+  for (int d = 0; d < NUM_DEVICES; d++) {
+    event->missingBits[d] = missingBits[d] & zones[z].mask[d];
+    if (event->missingBits[d])
+      event->devices |= 1 << d;
+  }
+  event->stamp.prevScanUs = 0;
+  event->stamp.onsetUs = 0;
+  event->stamp.confirmUs = micros();
+  event->occlusion.clear();
+}
+
+// [新增] 逐分区判断：按分区自己的 n、k 重新统计去抖历史，与分区掩码整字相交
+void evaluateZones(const uint64_t missing[NUM_DEVICES],
+                   const bool valid[NUM_DEVICES]) {
+  unsigned long nowMs = millis();
+  for (int z = 0; z < zoneCount; z++) {
+    const Zone &zone = zones[z];
+    if (!zone.enabled)
+      continue;
+
+    int missingNow = countZoneBits(zone.mask, missing);
+    bool allValid = true;
+    for (int d = 0; d < NUM_DEVICES; d++)
+      if (zone.mask[d] && !valid[d])
+        allValid = false;
+
+    uint8_t n = debounce.scansFor(zone.windowMs);
+    uint8_t k = debounce.scansFor(zone.debounceMs);
+    if (n < k)
+      n = k;
+    int confirmed = 0;
+    for (int d = 0; d < NUM_DEVICES; d++) {
+      if (zone.mask[d] && valid[d])
+        confirmed +=
+            __builtin_popcountll(debounce.evaluate(d, n, k) & zone.mask[d]);
+    }
+
+    // 触发后不清空去抖历史：须分区内无缺失且窗口内的确认也已消退才算清除，
+    // 否则重新布防时窗口中残留的缺失会立即再次触发
+    zoneArm[z].update(TRIGGER_REARM_POLICY,
+                      allValid && missingNow == 0 && confirmed < zone.tolerance,
+                      nowMs);
+    if (missingNow == 0)
+      zoneFiltered[z] = false;
+    if (!zoneArm[z].isArmed() || confirmed < zone.tolerance)
+      continue;
+
+    if (zone.filterCeiling > 0 && missingNow >= zone.filterCeiling) {
+      if (!zoneFiltered[z]) {
+        zoneFiltered[z] = true;
+        Serial.printf(">>> ZONE %s FILTERED: Missing=%d >= Ceiling=%d <<<\n",
+                      zone.name, missingNow, zone.filterCeiling);
+        metrics.filteredTriggers.inc();
+        if (TRIGGER_PUBLISH_FILTERED)
+          queueZoneTrigger(z, 0, true, confirmed, missingNow, missing);
+      }
+      continue;
+    }
+    if (zoneFiltered[z])
+      continue;
+
+    if (!zoneArm[z].fire(TRIGGER_REARM_POLICY, nowMs)) {
+      Serial.printf(">>> ZONE %s RATE LIMITED: Confirmed=%d <<<\n", zone.name,
+                    confirmed);
+      metrics.suppressedTriggers.inc();
+      continue;
+    }
+    Serial.printf(">>> ZONE %s TRIGGERED #%lu: Confirmed=%d Missing=%d <<<\n",
+                  zone.name, (unsigned long)zoneArm[z].getSequence(), confirmed,
+                  missingNow);
+    metrics.triggers.inc();
+    queueZoneTrigger(z, zoneArm[z].getSequence(), false, confirmed, missingNow,
+                     missing);
+  }
+}
+
+// [新增] 记录可用率标记变化，并按 AVAILABILITY_ACTION 处理新标记的光束
+void handleAvailabilityChanges() {
+  uint64_t low[NUM_DEVICES], recovered[NUM_DEVICES];
+  availability.takeChanges(low, recovered);
+  bool shieldChanged = false, baselineChanged = false;
+  uint8_t staged[NUM_DEVICES][NUM_INPUTS_PER_DEVICE];
+  memcpy(staged, globalShielding, sizeof(staged));
+
+  for (int d = 0; d < NUM_DEVICES; d++) {
+    for (uint64_t m = recovered[d]; m; m &= m - 1) {
+      int i = __builtin_ctzll(m);
+      Serial.printf("[AVAIL] Dev %d input %d recovered: %d%%\n", d + 1, i + 1,
+                    availability.getPercent(d, i));
+    }
+    for (uint64_t m = low[d]; m; m &= m - 1) {
+      int i = __builtin_ctzll(m);
+      Serial.printf("[AVAIL] Dev %d input %d unreliable: %d%% < %d%%\n", d + 1,
+                    i + 1, availability.getPercent(d, i), AVAIL_LOW_PERCENT);
+#if AVAILABILITY_ACTION == 1
+      staged[d][i] = 1;
+      shieldChanged = true;
+#elif AVAILABILITY_ACTION == 2
+      baseline[d][i] = 0;
+      baselineChanged = true;
+#endif
+    }
+  }
+
+  if (shieldChanged) {
+    // 整批一次写入 Flash，回调中会重算基线
+    int changed = webServer.applyShieldingBatch(staged);
+    Serial.printf("[AVAIL] Auto-shielded %d points\n", changed);
+  }
+  if (baselineChanged) {
+    Serial.println("[AVAIL] Unreliable beams retired from baseline");
+    recalculateBaselineCounts();
+  }
 }
 
 // ========== 核心监测逻辑 (独立设备、独立配置) ==========
 bool checkForChanges() {
   if (currentState != BASELINE_ACTIVE)
     return false;
+  TRACE_SCOPE("checkForChanges");
+  debounce.beginScan(micros());
+  latency.beginScan();
+  // 整轮扫描使用同一份配置，在线修改只在扫描之间切换
+  const DetectionConfig &config = detectionConfig.current();
 
   uint8_t currentScan[NUM_DEVICES][NUM_INPUTS_PER_DEVICE];
+  PackedScan packedScan = {};
   bool deviceReadSuccess[NUM_DEVICES] = {false, false, false, false};
-  bool anyDeviceTriggered = false;
+  uint8_t triggeredDevices = 0; // 达到容差的设备 (按位)
   int totalMissingBits = 0;  // 累计所有设备的缺失点数
+  uint64_t missingMasks[NUM_DEVICES] = {0, 0, 0, 0};
+  int confirmedCounts[NUM_DEVICES] = {0, 0, 0, 0};
+
+  metrics.scansTotal.inc();
+  occlusion.clear();
 
   // 1. 扫描所有设备，记录读取成功/失败
   for (int d = 1; d <= NUM_DEVICES; d++) {
-    if (readInputStatus(d, currentScan[d - 1])) {
+    if (readInputStatus(d, currentScan[d - 1], &packedScan.bits[d - 1])) {
       deviceReadSuccess[d - 1] = true;
+      packedScan.validMask |= 1 << (d - 1);
       deviceReadFailCount[d - 1] = 0;  // 重置失败计数
+      latency.recordRead(d - 1, micros());
+      uint32_t stamp = PerfStats::now();
       webServer.updateAllDeviceStates(d, currentScan[d - 1]);
+      perf.lap(d, PHASE_WEB, stamp);
     } else {
       deviceReadFailCount[d - 1]++;
       Serial.printf("Dev %d read failed (count: %d/%d)\n", d, 
@@ -491,12 +1356,17 @@ bool checkForChanges() {
     }
     delay(3);
   }
+  packedScan.timeMs = millis();
+  recordScan(packedScan);
 
   // 2. 打印日志 (每200ms) 并广播到 WebServer
   if (millis() - lastLogTime > 200) {
+    uint32_t stamp = PerfStats::now();
     printDeviceData("MONITOR SCAN", currentScan);
+    perf.lap(PERF_SCAN_WIDE, PHASE_LOG, stamp);
     lastLogTime = millis();
     webServer.broadcastStates();
+    perf.lap(PERF_SCAN_WIDE, PHASE_WEB, stamp);
   }
 
   // 3. 逐个设备独立判断
@@ -508,7 +1378,9 @@ bool checkForChanges() {
     }
 
     // 逐位比较
+    uint32_t stamp = PerfStats::now();
     int missingBits = 0;
+    uint64_t missingMask = 0;
     for (int i = 0; i < NUM_INPUTS_PER_DEVICE; i++) {
       bool isShielded = webServer.getShieldState(d + 1, i + 1);
       uint8_t maskedBaseline = isShielded ? 0 : baseline[d][i];
@@ -516,10 +1388,22 @@ bool checkForChanges() {
 
       if (maskedBaseline == 1 && maskedCurrent == 0) {
         missingBits++;
+        missingMask |= 1ULL << i;
       }
     }
 
     totalMissingBits += missingBits;
+    missingMasks[d] = missingMask;
+    availability.add(d, packedScan.bits[d]);
+    unsigned long readUs = latency.getLastRead(d);
+    unsigned long prevUs = latency.getPrevRead(d);
+    if (motion.update(d, missingMask, prevUs ? prevUs : readUs, readUs))
+      motionPending = true;
+    uint64_t confirmedMask = debounce.update(d, missingMask);
+    int confirmedBits = __builtin_popcountll(confirmedMask);
+    confirmedCounts[d] = confirmedBits;
+    uint8_t widestRun = occlusion.add(d + 1, confirmedMask);
+    perf.lap(d + 1, PHASE_DETECT, stamp);
 
     // [调试日志] 每2秒打印一次
     static unsigned long lastDebugLog = 0;
@@ -527,80 +1411,225 @@ bool checkForChanges() {
       Serial.printf("[DEBUG] Dev %d: MissingBits=%d (bitwise)\n", d + 1, missingBits);
     }
 
-    int myTolerance = DEVICE_TOLERANCE[d];
-    int myDebounceTarget = DEVICE_DEBOUNCE[d];
-
-    if (missingBits >= myTolerance) {
-      currentConsecutiveErrors[d]++;
+    int myTolerance = config.tolerance[d];
 
-      Serial.printf(">> Dev %d ALARM: Missing %d bits (Thresh %d). Count %d/%d\n", 
-                    d + 1, missingBits, myTolerance, 
-                    currentConsecutiveErrors[d], myDebounceTarget);
+    // 任一光束开始缺失即记为一次缺失过程的起点 (端到端延迟的 onset)
+    bool wideEnough = widestRun >= config.minRunWidth[d];
+    EpisodeEvent episode =
+        latency.update(d, missingBits, confirmedBits, myTolerance,
+                       debounce.pending(d), wideEnough);
 
-      if (currentConsecutiveErrors[d] == 1) {
+    if (missingBits >= myTolerance) {
+      Serial.printf(">> Dev %d ALARM: Missing %d bits (Thresh %d). Confirmed %d (%d of %d scans)\n",
+                    d + 1, missingBits, myTolerance, confirmedBits,
+                    debounce.getMinScans(d), debounce.getWindowScans(d));
+      if (episode == EPISODE_START) {
         Serial.printf("   Missing positions: ");
-        for (int i = 0; i < NUM_INPUTS_PER_DEVICE; i++) {
-          bool isShielded = webServer.getShieldState(d + 1, i + 1);
-          uint8_t maskedBaseline = isShielded ? 0 : baseline[d][i];
-          uint8_t maskedCurrent = isShielded ? 0 : currentScan[d][i];
-          if (maskedBaseline == 1 && maskedCurrent == 0) {
-            Serial.printf("%d ", i + 1);
-          }
-        }
+        for (uint64_t m = missingMask; m; m &= m - 1)
+          Serial.printf("%d ", __builtin_ctzll(m) + 1);
         Serial.println();
       }
+    } else if (episode == EPISODE_END) {
+      // 窗口内已无任何缺失记录，本次缺失过程结束
+      Serial.printf("Dev %d recovered (window clear)\n", d + 1);
+    }
 
-      if (currentConsecutiveErrors[d] >= myDebounceTarget) {
-        anyDeviceTriggered = true;
-      }
-
-    } else {
-      if (currentConsecutiveErrors[d] > 0) {
-        Serial.printf("Dev %d recovered (Count reset)\n", d + 1);
-      }
-      currentConsecutiveErrors[d] = 0;
+    if (latency.inEpisode(d) && confirmedBits >= myTolerance) {
+      if (!wideEnough)
+        Serial.printf(">> Dev %d: %d confirmed bits scattered (widest run %d < %d)\n",
+                      d + 1, confirmedBits, widestRun, config.minRunWidth[d]);
+      else
+        triggeredDevices |= 1 << d; // 已由 latency.update() 确认
     }
 
     if (d == NUM_DEVICES - 1 && millis() - lastDebugLog > 2000) {
       lastDebugLog = millis();
     }
+    perf.lap(d + 1, PHASE_LOG, stamp); // 去抖计数及其串口日志
   }
 
-  // 4. 触发判断 + 过滤阈值检查
-  if (anyDeviceTriggered) {
+  if (availability.endScan())
+    handleAvailabilityChanges();
+
+  // [新增] 校准期间光路应无遮挡，只统计噪声，不做分区/设备触发
+  if (calibrator.isRunning()) {
+    if (calibrator.observe(debounce, missingMasks, deviceReadSuccess, millis()))
+      applyCalibration();
+    return false;
+  }
+
+  // 4. 分区判断
+  if (zoneCount > 0) {
+    uint32_t stamp = PerfStats::now();
+    evaluateZones(missingMasks, deviceReadSuccess);
+    perf.lap(PERF_SCAN_WIDE, PHASE_DETECT, stamp);
+  }
+
+  // 5. 重新布防：每台读取成功的设备当前缺失数和窗口内确认数都低于其容差才算清除，
+  //    低于容差的零散缺失 (灰尘) 或持续读取失败的设备不会让触发一直锁定；
+  //    触发后不清空去抖历史 (分区共用)，确认数消退前不重新布防
+  bool anyRead = false, allClear = true;
+  for (int d = 0; d < NUM_DEVICES; d++) {
+    if (!deviceReadSuccess[d])
+      continue;
+    anyRead = true;
+    if (__builtin_popcountll(missingMasks[d]) >= config.tolerance[d] ||
+        confirmedCounts[d] >= config.tolerance[d])
+      allClear = false;
+  }
+  allClear = allClear && anyRead;
+  triggerArm.update(TRIGGER_REARM_POLICY, allClear, millis());
+  metrics.triggerArmState.set(triggerArm.getState());
+  if (allClear)
+    deviceFiltered = false;
+
+  // 6. 触发判断 + 过滤阈值检查
+  if (latency.confirmed()) {
     // [新功能] 触发点过滤：如果缺失点数超过阈值，认为是误触发
+    // 与分区相同只计一次：物体停留期间反复确认不重复计数、不重复发布
     if (triggerFilterThreshold > 0 && totalMissingBits >= triggerFilterThreshold) {
-      Serial.printf(">>> TRIGGER FILTERED: TotalMissing=%d >= Threshold=%d <<<\n", 
-                    totalMissingBits, triggerFilterThreshold);
-      for (int i = 0; i < NUM_DEVICES; i++)
-        currentConsecutiveErrors[i] = 0;
+      if (!deviceFiltered) {
+        deviceFiltered = true;
+        Serial.printf(">>> TRIGGER FILTERED: TotalMissing=%d >= Threshold=%d <<<\n",
+                      totalMissingBits, triggerFilterThreshold);
+        metrics.filteredTriggers.inc();
+        if (TRIGGER_PUBLISH_FILTERED)
+          queueDeviceTrigger(0, true, triggeredDevices, totalMissingBits,
+                             missingMasks);
+      }
       return false;  // 过滤掉这次触发
     }
-    
-    Serial.printf(">>> TRIGGER CONFIRMED: TotalMissing=%d <<<\n", totalMissingBits);
-    for (int i = 0; i < NUM_DEVICES; i++)
-      currentConsecutiveErrors[i] = 0;
+
+    if (deviceFiltered)
+      return false;
+    // 尚未重新布防 (物体未离开或处于不应期) 时不重复触发
+    if (!triggerArm.isArmed())
+      return false;
+    if (!triggerArm.fire(TRIGGER_REARM_POLICY, millis())) {
+      Serial.printf(">>> TRIGGER RATE LIMITED: TotalMissing=%d <<<\n",
+                    totalMissingBits);
+      metrics.suppressedTriggers.inc();
+      return false;
+    }
+
+    Serial.printf(">>> TRIGGER CONFIRMED #%lu: TotalMissing=%d, %d runs, widest %d <<<\n",
+                  (unsigned long)triggerArm.getSequence(), totalMissingBits,
+                  occlusion.getRunCount(), occlusion.getMaxWidth());
+    metrics.triggers.inc();
+    queueDeviceTrigger(triggerArm.getSequence(), false, triggeredDevices,
+                       totalMissingBits, missingMasks);
     return true;
   }
 
   return false;
 }
 
-void handleTriggerDetected() {
-  if (triggerSent)
+// [新增] 发布最近一次速度估计
+void publishMotion() {
+  if (!motionPending || !client.connected())
     return;
+  char payload[160];
+  FixedBufferPrint out(payload, sizeof(payload));
+  motion.writeJSON(out);
+  const MotionEstimate &m = motion.getLatest();
+  Serial.printf("Motion: Dev %d -> Dev %d, %lu mm/s, length %lu mm\n",
+                m.fromDevice, m.toDevice, (unsigned long)m.speedMmS,
+                (unsigned long)m.lengthMm);
+  if (client.publish(motion_topic, (const uint8_t *)payload, out.length()))
+    motionPending = false;
+}
 
-  if (!client.connected()) {
-    Serial.println("Trigger pending - MQTT disconnected");
-    return;
+// [新增] 触发负载：文档与编码缓冲区均静态分配，发布路径不占用堆
+// 负载携带序号和各阶段时间戳，接收端可据此发现丢失并核对端到端延迟；
+// missingBits 为各设备缺失光束位图 (bit i = 输入 i+1)，runs 为连续遮挡段 [设备, 起始输入, 宽度]
+// 文档容量按最坏情况估算：16 个遮挡段各占 4 个槽位，另有约 20 个字段/元素
+StaticJsonDocument<2048> triggerDoc;
+uint8_t triggerPayload[640];
+
+size_t encodeTriggerPayload(const TriggerEvent &event, unsigned long publishUs) {
+  triggerDoc.clear();
+  if (event.zone >= 0)
+    triggerDoc["zone"] = (const char *)event.zoneName;
+  triggerDoc["seq"] = event.seq;
+  triggerDoc["filtered"] = event.filtered;
+  JsonArray devices = triggerDoc.createNestedArray("devices");
+  for (int d = 0; d < NUM_DEVICES; d++)
+    if (event.devices & (1 << d))
+      devices.add(d + 1);
+  if (event.zone >= 0)
+    triggerDoc["confirmed"] = event.confirmed;
+  triggerDoc["missing"] = event.missing;
+  JsonArray bits = triggerDoc.createNestedArray("missingBits");
+  for (int d = 0; d < NUM_DEVICES; d++)
+    bits.add(event.missingBits[d]);
+  if (event.zone < 0) {
+    triggerDoc["prevScanUs"] = event.stamp.prevScanUs;
+    triggerDoc["onsetUs"] = event.stamp.onsetUs;
+  }
+  triggerDoc["confirmUs"] = event.stamp.confirmUs;
+  triggerDoc["publishUs"] = publishUs;
+  if (event.zone < 0) {
+    JsonArray runs = triggerDoc.createNestedArray("runs");
+    for (int r = 0; r < event.occlusion.getRunCount(); r++) {
+      const OcclusionRun &run = event.occlusion.getRun(r);
+      JsonArray item = runs.createNestedArray();
+      item.add(run.device);
+      item.add(run.start);
+      item.add(run.width);
+    }
+    triggerDoc["runsTruncated"] = event.occlusion.overflowed();
   }
+  if (triggerDoc.overflowed())
+    return 0;
+  // 先测量长度，放不下时不发布截断的负载 (serializeJson 会截断并补 NUL)
+#if TRIGGER_PAYLOAD_JSON
+  if (measureJson(triggerDoc) >= sizeof(triggerPayload))
+    return 0;
+  return serializeJson(triggerDoc, (char *)triggerPayload,
+                       sizeof(triggerPayload));
+#else
+  if (measureMsgPack(triggerDoc) > sizeof(triggerPayload))
+    return 0;
+  return serializeMsgPack(triggerDoc, triggerPayload, sizeof(triggerPayload));
+#endif
+}
 
-  Serial.println("Publishing receiver/triggered");
-  if (client.publish(mqtt_topic, "")) {
-    triggerSent = true;
-    Serial.println("Trigger sent successfully");
-  } else {
-    Serial.println("Trigger send failed");
+// [新增] 按顺序发布队列中的触发事件：设备级发布到 receiver/triggered，分区发布到各自主题
+void publishTriggers() {
+  while (triggerQueueCount > 0 && client.connected()) {
+    TriggerEvent &event = triggerQueue[triggerQueueHead];
+    const char *topic = event.topic;
+    size_t length = encodeTriggerPayload(event, micros());
+    if (length == 0) {
+      Serial.println("Trigger payload overflow - event dropped");
+      triggerQueueHead = (triggerQueueHead + 1) % TRIGGER_QUEUE_SIZE;
+      triggerQueueCount--;
+      continue;
+    }
+
+    TRACE_SCOPE("mqtt.publish");
+    if (!client.publish(topic, triggerPayload, length)) {
+      Serial.printf("Trigger send failed (%s)\n", topic);
+      return;
+    }
+    unsigned long sentUs = micros();
+    if (event.filtered) {
+      // 被过滤的事件不是报警，不计入触发延迟
+      Serial.printf("Filtered trigger sent to %s\n", topic);
+    } else if (event.zone < 0) {
+      uint32_t totalUs =
+          TriggerLatency::observe(event.stamp, sentUs);
+      Serial.printf("Trigger #%lu sent successfully (scan->publish %lu us)\n",
+                    (unsigned long)event.seq, (unsigned long)totalUs);
+      if (totalUs > TRIGGER_LATENCY_BUDGET_US)
+        Serial.printf("   Latency over budget (%lu us)\n",
+                      (unsigned long)TRIGGER_LATENCY_BUDGET_US);
+    } else {
+      Serial.printf("Zone %s trigger #%lu sent to %s\n",
+                    event.zoneName, (unsigned long)event.seq, topic);
+    }
+    triggerQueueHead = (triggerQueueHead + 1) % TRIGGER_QUEUE_SIZE;
+    triggerQueueCount--;
   }
 }
 
@@ -621,20 +1650,37 @@ void setup() {
 
   webServer.begin();
 
-  loadShieldingConfig();                                    // [新增] 加载配置
+  loadConfig();                     // [新增] 加载配置记录 (屏蔽、过滤阈值、检测参数、分区)
   webServer.loadShielding(globalShielding);                 // 同步到 WebServer
   webServer.setShieldingChangeCallback(onShieldingChanged); // 注册回调
   webServer.setClearShieldingCallback(onClearShielding);    // 注册清空回调
+  webServer.setShieldingBatchCallback(onShieldingBatchChanged); // 注册批量回调
 
-  loadTriggerFilterThreshold();                             // 加载过滤阈值
   webServer.setTriggerFilterThreshold(triggerFilterThreshold);  // 同步到 WebServer
   webServer.setTriggerFilterCallback(onTriggerFilterThresholdChanged);  // 注册回调
 
-  currentState = ACTIVE;
+  webServer.setZones(zones, zoneCount);                     // [新增] 分区随配置记录加载
+  webServer.setZonesCallback(onZonesChanged);
+
+  webServer.setCalibrationCallback(onCalibrationRequested);
+
+  loadProfiles();                                           // [新增] 加载配置方案
+  webServer.setProfileCallback(onProfileRequested);
+
+  const DetectionConfig &config = detectionConfig.current();
+  webServer.setBaselineDelay(config.baselineDelayMs);
+  for (int d = 0; d < NUM_DEVICES; d++) {
+    debounce.configure(d, config.debounceWindowMs[d],
+                       config.debounceMissingMs[d]);
+    motion.setPosition(d, DEVICE_POSITION_MM[d]);
+  }
+
+  currentState = restoreBaselineSnapshot() ? BASELINE_ACTIVE : ACTIVE;
   Serial.println("System ready.");
 }
 
 void loop() {
+  TRACE_SCOPE("loop");
   if (!client.connected())
     reconnect();
   else
@@ -643,63 +1689,58 @@ void loop() {
   webServer.handleClient();
 
   unsigned long now = millis();
+  metrics.tick(now);
+
+  // [新增] 扫描边界：在线修改的检测参数在此切换；建立基线期间推迟，保证同一次基线参数一致
+  if (currentState < BASELINE_WAITING || currentState > BASELINE_CALC)
+    applyPendingConfig();
+  const DetectionConfig &config = detectionConfig.current();
 
   switch (currentState) {
   case IDLE:
     break;
   case ACTIVE:
+    if (now - lastBackgroundScan >= config.backgroundScanIntervalMs) {
+      lastBackgroundScan = now;
+      backgroundScan();
+    }
     break;
 
   case BASELINE_WAITING:
     if (now >= baselineSetTime) {
       Serial.println("\n=== BASELINE SCAN #0 ===");
-      currentState = BASELINE_INIT_0;
-      baselineSetTime = millis() + baselineScanInterval;
+      baselineAccumulator.reset();
+      currentState = BASELINE_SCANNING;
+      baselineSetTime = millis() + config.baselineScanIntervalMs;
     }
     break;
 
-  case BASELINE_INIT_0:
+  case BASELINE_SCANNING:
     if (now >= baselineSetTime) {
-      if (!scanBaseline(init_0)) {
-        Serial.println("Scan #0 FAILED - Aborting");
+      uint8_t sample[NUM_DEVICES][NUM_INPUTS_PER_DEVICE];
+      PackedScan packed;
+      int n = baselineAccumulator.getSamples();
+      if (!scanBaseline(sample, &packed)) {
+        Serial.printf("Scan #%d FAILED - Aborting\n", n);
         currentState = ACTIVE;
         return;
       }
-      Serial.printf("Scan #0 completed: %d active bits\n",
-                    countActiveBits(init_0));
-      Serial.println("\n=== BASELINE SCAN #1 ===");
-      currentState = BASELINE_INIT_1;
-      baselineSetTime = millis() + baselineScanInterval;
-    }
-    break;
-
-  case BASELINE_INIT_1:
-    if (now >= baselineSetTime) {
-      if (!scanBaseline(init_1)) {
-        Serial.println("Scan #1 FAILED - Aborting");
-        currentState = ACTIVE;
-        return;
+      baselineAccumulator.add(packed);
+      Serial.printf("Scan #%d completed: %d active bits\n", n,
+                    countActiveBits(sample));
+      if (baselineAccumulator.getSamples() >= config.baselineSamples) {
+        Serial.printf("\n=== CALCULATING FINAL BASELINE (%d-of-%d) ===\n",
+                      config.baselineMinVotes, config.baselineSamples);
+        currentState = BASELINE_CALC;
+      } else {
+        Serial.printf("\n=== BASELINE SCAN #%d ===\n", n + 1);
+        baselineSetTime = millis() + config.baselineScanIntervalMs;
       }
-      Serial.printf("Scan #1 completed: %d active bits\n",
-                    countActiveBits(init_1));
-      Serial.println("\n=== BASELINE SCAN #2 ===");
-      currentState = BASELINE_INIT_2;
-      baselineSetTime = millis() + baselineScanInterval;
     }
     break;
 
-  case BASELINE_INIT_2:
-    if (now >= baselineSetTime) {
-      if (!scanBaseline(init_2)) {
-        Serial.println("Scan #2 FAILED - Aborting");
-        currentState = ACTIVE;
-        return;
-      }
-      Serial.printf("Scan #2 completed: %d active bits\n",
-                    countActiveBits(init_2));
-      Serial.println("\n=== CALCULATING FINAL BASELINE (AND Logic) ===");
-      currentState = BASELINE_CALC;
-    }
+  case BASELINE_CONFIRM:
+    confirmFastBaseline();
     break;
 
   case BASELINE_CALC:
@@ -707,9 +1748,15 @@ void loop() {
     break;
 
   case BASELINE_ACTIVE:
-    if (checkForChanges()) {
-      handleTriggerDetected();
-    }
+    checkForChanges();
+    publishMotion();
     break;
   }
+
+  // 触发事件与状态无关地发布，重新建立基线期间也不积压
+  publishTriggers();
+
+  // [新增] 配置写回：静默期满或收到保存请求时合并写入 Flash
+  if (configJournal.due(millis()))
+    flushConfigJournal();
 }
\ No newline at end of file
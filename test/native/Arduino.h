@@ -0,0 +1,41 @@
+#ifndef Arduino_h
+#define Arduino_h
+
+// env:native 主机测试用的最小 Arduino 接口，只覆盖 build_src_filter 中模块用到的部分；
+// millis()/micros() 由测试提供 (模拟时钟)
+#include <cstdarg>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+unsigned long millis();
+unsigned long micros();
+
+class Print {
+public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t *buffer, size_t size) {
+    size_t n = 0;
+    while (size--)
+      n += write(*buffer++);
+    return n;
+  }
+  size_t print(const char *s) { return write((const uint8_t *)s, strlen(s)); }
+  size_t print(char c) { return write((uint8_t)c); }
+  size_t printf(const char *format, ...) {
+    char buf[256];
+    va_list args;
+    va_start(args, format);
+    int len = vsnprintf(buf, sizeof(buf), format, args);
+    va_end(args);
+    if (len < 0)
+      return 0;
+    if ((size_t)len >= sizeof(buf))
+      len = sizeof(buf) - 1;
+    return write((const uint8_t *)buf, len);
+  }
+};
+
+#endif
@@ -0,0 +1,207 @@
+// 端到端触发延迟：模拟 RS485 总线 + 本地模拟 broker，按 checkForChanges()/
+// publishTriggers() 的顺序调用固件的 DebounceEngine、TriggerLatency 和
+// TriggerArm，检查 onset -> confirm -> publish 的延迟预算
+#include "DebounceEngine.h"
+#include "Metrics.h"
+#include "TriggerArm.h"
+#include "TriggerLatency.h"
+#include <unity.h>
+
+#define NUM_DEVICES 4
+#define TOLERANCE 1            // DEVICE_TOLERANCE
+#define DEBOUNCE_WINDOW_MS 90  // DEVICE_DEBOUNCE_WINDOW_MS
+#define DEBOUNCE_MISSING_MS 60 // DEVICE_DEBOUNCE_MISSING_MS
+
+// 与 main.cpp 的 TRIGGER_REARM_POLICY 相同
+static const ReArmPolicy REARM_POLICY = {true, 300, 1000, 20};
+
+// 模拟时钟：总线收发、设备间延时和 broker 往返都推进时间
+static unsigned long fakeUs = 0;
+unsigned long micros() { return fakeUs; }
+unsigned long millis() { return fakeUs / 1000; }
+
+// 模拟 Modbus 从站 (功能码 0x02，48 路输入)：115200 8N1 下
+// 8 字节请求 + 11 字节应答，加上收发切换，单次往返约 2ms
+#define BUS_BAUD 115200
+#define BUS_FRAME_BYTES (8 + 11)
+#define BUS_TURNAROUND_US 350
+#define INTER_DEVICE_DELAY_US 3000 // 扫描循环中设备之间的 delay(3)
+#define SCAN_OVERHEAD_US 2000      // 比较、日志和网页广播
+
+class FakeModbusReader {
+private:
+  uint64_t blocked[NUM_DEVICES]; // 当前被遮挡的光束
+
+public:
+  void clear() { memset(blocked, 0, sizeof(blocked)); }
+  void block(int device, uint64_t mask) { blocked[device] = mask; }
+  // 基线全亮，返回本次读到的缺失掩码
+  uint64_t read(int device) {
+    fakeUs += BUS_FRAME_BYTES * 10 * 1000000UL / BUS_BAUD + BUS_TURNAROUND_US;
+    return blocked[device];
+  }
+};
+
+// 本地模拟 broker：publish() 完成时刻即 sentUs
+class FakePublisher {
+public:
+  unsigned long rttUs;
+  bool connected;
+  int received;
+
+  void reset() {
+    rttUs = 4000;
+    connected = true;
+    received = 0;
+  }
+  bool publish() {
+    if (!connected)
+      return false;
+    fakeUs += rttUs;
+    received++;
+    return true;
+  }
+};
+
+static DebounceEngine debounce;
+static TriggerLatency latency;
+static FakeModbusReader bus;
+static FakePublisher broker;
+static TriggerArm arm;
+
+// 待发布的触发 (对应 TriggerEvent::stamp)
+static bool queued;
+static LatencyStamp queuedStamp;
+
+static uint32_t detectCount, detectSum, publishSum, totalCount, totalSum;
+
+void setUp() {
+  fakeUs = 1000000;
+  debounce.reset();
+  latency.reset();
+  bus.clear();
+  broker.reset();
+  arm.reset();
+  queued = false;
+  for (int d = 0; d < NUM_DEVICES; d++)
+    debounce.configure(d, DEBOUNCE_WINDOW_MS, DEBOUNCE_MISSING_MS);
+  detectCount = metrics.triggerDetectLatency.getCount();
+  detectSum = metrics.triggerDetectLatency.getSum();
+  publishSum = metrics.triggerPublishLatency.getSum();
+  totalCount = metrics.triggerLatency.getCount();
+  totalSum = metrics.triggerLatency.getSum();
+}
+
+void tearDown() {}
+
+// 一轮扫描：先依次读取各设备，再逐设备去抖判断
+static void scanOnce() {
+  debounce.beginScan(micros());
+  uint64_t missing[NUM_DEVICES];
+  for (int d = 0; d < NUM_DEVICES; d++) {
+    missing[d] = bus.read(d);
+    latency.recordRead(d, micros());
+    fakeUs += INTER_DEVICE_DELAY_US;
+  }
+
+  latency.beginScan();
+  bool allClear = true;
+  for (int d = 0; d < NUM_DEVICES; d++) {
+    int missingBits = __builtin_popcountll(missing[d]);
+    int confirmed = __builtin_popcountll(debounce.update(d, missing[d]));
+    // 默认不限制遮挡段宽度 (minRunWidth = 1)，qualified 恒为 true
+    latency.update(d, missingBits, confirmed, TOLERANCE, debounce.pending(d),
+                   true);
+    if (missingBits >= TOLERANCE || confirmed >= TOLERANCE)
+      allClear = false;
+  }
+
+  arm.update(REARM_POLICY, allClear, millis());
+  if (latency.confirmed() && arm.isArmed() && !queued &&
+      arm.fire(REARM_POLICY, millis())) {
+    queued = true;
+    queuedStamp = latency.stamp(micros());
+  }
+  fakeUs += SCAN_OVERHEAD_US;
+}
+
+static void publishOnce() {
+  if (!queued || !broker.publish())
+    return;
+  TriggerLatency::observe(queuedStamp, micros());
+  queued = false;
+}
+
+static void runScans(int count) {
+  for (int i = 0; i < count; i++) {
+    scanOnce();
+    publishOnce();
+  }
+}
+
+// 建立扫描周期估计后再遮挡
+static void warmUp() { runScans(10); }
+
+void test_trigger_latency_within_budget() {
+  warmUp();
+  unsigned long breakUs = fakeUs;
+  bus.block(1, 0xF0ULL);
+  runScans(10);
+
+  TEST_ASSERT_EQUAL_INT(1, broker.received);
+  TEST_ASSERT_EQUAL_UINT32(totalCount + 1, metrics.triggerLatency.getCount());
+  TEST_ASSERT_EQUAL_UINT32(detectCount + 1,
+                           metrics.triggerDetectLatency.getCount());
+
+  uint32_t detectUs = metrics.triggerDetectLatency.getSum() - detectSum;
+  uint32_t publishUs = metrics.triggerPublishLatency.getSum() - publishSum;
+  uint32_t totalUs = metrics.triggerLatency.getSum() - totalSum;
+  TEST_ASSERT_EQUAL_UINT32(detectUs + publishUs, totalUs);
+  // 去抖至少需要第二轮扫描确认；onset 是断光后的首次读取
+  TEST_ASSERT_GREATER_OR_EQUAL_UINT32(debounce.getScanPeriodUs() / 2, detectUs);
+  TEST_ASSERT_TRUE(queuedStamp.onsetUs > breakUs);
+  TEST_ASSERT_TRUE(queuedStamp.prevScanUs <= breakUs);
+  TEST_ASSERT_GREATER_OR_EQUAL_UINT32(broker.rttUs, publishUs);
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(TRIGGER_LATENCY_BUDGET_US, totalUs);
+}
+
+void test_single_scan_glitch_not_published() {
+  warmUp();
+  bus.block(2, 0x3ULL);
+  runScans(1);
+  bus.clear();
+  runScans(10);
+
+  TEST_ASSERT_EQUAL_INT(0, broker.received);
+  TEST_ASSERT_EQUAL_UINT32(totalCount, metrics.triggerLatency.getCount());
+}
+
+// broker 断线期间时间戳保持在排队的事件中，重连后的发布延迟计入直方图
+void test_publish_outage_counted_in_latency() {
+  warmUp();
+  broker.connected = false;
+  bus.block(0, 0x7ULL);
+  runScans(10);
+  TEST_ASSERT_EQUAL_INT(0, broker.received);
+  TEST_ASSERT_EQUAL_UINT32(totalCount, metrics.triggerLatency.getCount());
+
+  unsigned long reconnectUs = fakeUs;
+  broker.connected = true;
+  runScans(1);
+
+  TEST_ASSERT_EQUAL_INT(1, broker.received);
+  uint32_t detectUs = metrics.triggerDetectLatency.getSum() - detectSum;
+  uint32_t publishUs = metrics.triggerPublishLatency.getSum() - publishSum;
+  uint32_t totalUs = metrics.triggerLatency.getSum() - totalSum;
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(TRIGGER_LATENCY_BUDGET_US, detectUs);
+  TEST_ASSERT_GREATER_THAN_UINT32(reconnectUs - queuedStamp.confirmUs, publishUs);
+  TEST_ASSERT_GREATER_THAN_UINT32(TRIGGER_LATENCY_BUDGET_US, totalUs);
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_trigger_latency_within_budget);
+  RUN_TEST(test_single_scan_glitch_not_published);
+  RUN_TEST(test_publish_outage_counted_in_latency);
+  return UNITY_END();
+}